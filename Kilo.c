@@ -4,19 +4,36 @@
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE
 #define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64 // 64-bit off_t so files past 2GB work on 32-bit hosts too
 
 #include <ctype.h> // Control characters
 #include <stdio.h> // standard IO module for printf
 #include <fcntl.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <stdint.h> // fixed width ints for offsets past 2GB
 #include <string.h>
 #include <sys/ioctl.h> // Get size of terminal window
+#include <sys/stat.h>  // file size / mtime for the swap journal
 #include <sys/types.h> // malloc & ssize_t come from this import
 #include <stdlib.h>    // standard library - type conversion, mem alloc...
 #include <termios.h>   // importing variables for terminal
 #include <time.h>
 #include <unistd.h> // importing standard io module for input keys
+#include <signal.h> // SIGWINCH when the terminal is resized
+#include <stddef.h> // offsetof for searching the row checkpoints
+#include <sys/wait.h> // benchmark runs each trace in a child process
+#include <malloc.h>   // malloc_usable_size for the memory accounting
+#include <limits.h>   // UINT_MAX, no undo group
+#include <sys/mman.h>    // the loader and change detection read files through a mapping
+#include <sys/inotify.h> // noticing the file change on disk
+#ifdef KILO_ZLIB
+#include <zlib.h> // .gz files are inflated while loading and deflated on save
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h> // 16 bytes at a time ASCII check
+#endif
 
 // /*** defines ***/
 
@@ -24,6 +41,29 @@
 #define KILO_VERSION "0.0.1"
 #define KILO_TAB_STOP 8
 #define KILO_QUIT_TIMES 2
+#define KILO_UNDO_LIMIT (1024 * 1024) // default memory cap of the undo arena
+#define KILO_CHUNK_SIZE (64 * 1024)   // lines longer than this are stored as several rows
+#define KILO_JOURNAL_BATCH (64 * 1024)  // flush the swap journal once this much is pending
+#define KILO_JOURNAL_DEBOUNCE_MS 200    // ...or once edits have been quiet this long
+#define KILO_JOURNAL_MAX_DELAY_MS 1000  // ...or once the oldest pending edit is this old
+#define KILO_JOURNAL_MAGIC "KILOSWP3"
+#define KILO_SAVE_BUF (1024 * 1024)  // saves copy the rows out through a buffer this big
+#define KILO_TRACE_EVENTS (1 << 16) // --trace keeps the newest this many events
+#define KILO_LOAD_BATCH 65536         // rows the loader queues before inserting them together
+#define KILO_WATCH_BLOCK (64 * 1024)  // bytes per checksum when comparing with the file on disk
+#define KILO_WATCH_SETTLE_MS 100      // reload once the file has been quiet this long
+#define KILO_FOLLOW_MAX_READ (16 * 1024 * 1024) // most bytes follow mode loads per frame
+#define KILO_VIEW_STRIDE 1024                   // --view keeps the offset of every this many rows
+#define KILO_VIEW_SCAN_STEP (64 * 1024 * 1024)  // bytes --view indexes per idle tick
+#define KILO_VIEW_RELEASE (4 * 1024 * 1024)     // --view drops pages after reading this much
+#define KILO_GZ_SPAN (8 * 1024 * 1024)          // uncompressed bytes between .gz seek points
+#define KILO_INTERN_SEEN (1 << 25)              // most bits remembering row texts seen once (4MB)
+#define KILO_COLD_WINDOW 1024                   // rows either side of the screen and cursor never compressed
+#define KILO_COLD_ROWS 256                      // most rows compressed together in one block
+#define KILO_COLD_BLOCK (64 * 1024)             // ...or this much of their text
+#define KILO_COLD_SCAN (1024 * 1024)            // most rows one editorColdPoll looks at
+#define KILO_COLD_CACHE 4                       // blocks kept decompressed
+#define KILO_COLD_SCAN_BYTES (32 * 1024 * 1024) // most text compressed per idle tick
 
 // defining a constant / function
 #define CTRL_KEY(k) ((k) & 0x1f)
@@ -71,41 +111,452 @@ struct editorSyntax
   int flags;
 };
 
-// data type for storing row in text editor
+/**
+ * Marks a char that doesn't take exactly one byte and one column
+ * (a tab or a multibyte UTF-8 char), between two of these cx, rx
+ * and the render byte offset all move together one for one
+ */
+typedef struct rowCheckpoint
+{
+  size_t cx;  // chars index where the char starts
+  size_t cxe; // chars index just after it
+  size_t rx;  // render column where it starts
+  size_t rxe; // render column just after it (rxe - rx is the display width)
+  size_t rb;  // render byte where it starts
+  size_t rbe; // render byte just after it
+} rowCheckpoint;
+
+/**
+ * data type for storing row in text editor. Rows are split in two:
+ * the erow in E.row holds what passes over the whole file use (saving,
+ * searching, the comment state chain, soft wrap, loading), the
+ * rowDisplay at the same index in E.display what only drawing and
+ * cursor movement on the row need. A row's index is where it is in
+ * E.row, see ROW_IDX.
+ */
 typedef struct erow
 {
-  int idx; // allowing us to see if previous row is multi-line comment
-  int size;
-  int rsize;
-  char *chars;
+  char *chars;   // NULL while the row is frozen
+  size_t size;   // size_t so a single row can be bigger than 2GB
+  size_t rwidth; // screen columns the rendered row takes
+  struct coldBlock *cold; // text is compressed in here, see editorColdFreeze
+  uint32_t cold_off;      // where the text starts in its cold block
+  unsigned char hl_open_comment;
+  unsigned char cont; // chunk of a long line that carries on in the next row, no newline after it
+} erow;
+
+typedef struct rowDisplay
+{
   char *render;      // rendering tabs and other special chars
+  size_t rsize;
   unsigned char *hl; // highlight (unsigned char meaning ints 0-255)
-  int hl_open_comment;
-} erow;
+  rowCheckpoint *cp; // sorted cx <-> rx checkpoints, rebuilt by editorUpdateRow
+  size_t ncp;
+  struct rowShape *shape; // render / cp / hl borrowed from an interned text, NULL if they're the row's own
+  int ascii; // no UTF-8 in the row, every render byte is one screen column
+  int used;  // looked at since the eviction clock last passed, see editorEvictPoll
+} rowDisplay;
+
+#define ROW_IDX(row) ((size_t)((row) - E.row))
+#define ROW_DISPLAY(row) (&E.display[ROW_IDX(row)])
+
+// kinds of buffer mutation the undo journal can record
+enum editorOpType
+{
+  OP_INSERT = 1, // text inserted into a row
+  OP_DELETE,     // text removed from a row
+  OP_INSERT_ROW, // whole row inserted
+  OP_DELETE_ROW, // whole row removed
+  OP_SET_CONT,   // row's continuation flag changed, col is the new value
+  OP_REPLACE,    // replace-all, text is the strings and the packed match list
+  OP_PASTE,      // clipboard pasted over several rows, text is a clipOp
+  OP_CUT,        // ...and the range of rows cut to it
+  OP_CLIP,       // swap file only: the clipboard was copied from row, col to a clipOp's end
+  OP_CLIP_TEXT   // swap file only: the clipboard's spans in full, see editorJournalClip
+};
+
+// header of a single journal record, the text it touched follows it
+typedef struct editorOp
+{
+  unsigned char type;
+  unsigned int group; // keypress the op belongs to, undone together
+  size_t row;
+  size_t col;
+  size_t len; // bytes of text stored after the header
+} editorOp;
+
+/**
+ * Undo history lives in one arena of packed records:
+ *   [editorOp header][len bytes of text][size_t record length]
+ * the trailing length lets us walk backwards from the end.
+ * Records before 'top' can be undone, records after it redone.
+ */
+struct editorUndo
+{
+  char *buf;
+  size_t len;   // bytes in use
+  size_t cap;   // bytes allocated
+  size_t top;   // end of the undoable records
+  size_t limit; // memory cap for the whole arena
+  unsigned int group;
+  unsigned int lost; // keypress too big to keep whole, the rest of it isn't recorded
+  int over;   // the arena holds one replace-all past the limit, older history went for it
+  int paused; // don't record while loading a file or replaying history
+};
+
+/**
+ * Crash recovery journal - every buffer op is appended to a swap file
+ * next to the file being edited, so unsaved edits survive a crash.
+ * Ops are batched in memory and written out together, each as
+ *   [editorOp header][len bytes of text][uint64_t checksum of both]
+ * so a record that only partly reached the disk isn't replayed.
+ */
+struct editorJournal
+{
+  int fd;     // -1 until the first edit opens the swap file
+  char *path; // ".<name>.kswp" beside the edited file
+  char *pending;
+  size_t len; // bytes waiting to be written
+  size_t cap;
+  size_t last;          // offset of the newest pending record, for merging typed chars
+  uint64_t first_ms;    // when the oldest pending op was queued
+  uint64_t last_ms;     // when the newest pending op was queued
+  int paused;           // loading or replaying, ops are already on disk
+  struct clipData *clip; // clipboard recovery will have at this point, NULL if it can't rebuild it
+  int clip_deferred;     // ...copied before the first op, its OP_CLIP goes in ahead of that
+  size_t clip_y0, clip_x0, clip_y1, clip_x1;
+  off_t orig_size;      // identity of the file the journal applies to
+  time_t orig_mtime;
+  long orig_mtime_ns;   // same-size rewrites within one second differ only here
+  ino_t orig_ino;       // ...or in being a different file renamed into place
+  dev_t orig_dev;
+};
+
+/**
+ * Soft wrap layout cache - how many screen lines each row wraps onto,
+ * with a Fenwick tree over those counts so row <-> screen line lookups
+ * are O(log n). Edits inside a row update one entry, inserting or
+ * deleting rows (or resizing) rebuilds it the next time it's used.
+ */
+struct editorWrap
+{
+  int enabled;
+  int stale;     // needs a rebuild before it's used again
+  size_t n;      // rows covered
+  size_t cols;   // screen width the counts were worked out for
+  size_t *lines; // screen lines each row takes
+  size_t *tree;  // Fenwick tree over lines, 1-based
+  size_t top;    // first screen line shown
+};
+
+// what the editor's memory is used for, see editorMalloc
+enum editorMemTag
+{
+  MEM_ROWS = 0, // the E.row and E.display arrays
+  MEM_TEXT,     // row chars
+  MEM_RENDER,   // row render copies and their checkpoints
+  MEM_HL,       // row highlight arrays
+  MEM_SEARCH,   // search state
+  MEM_UNDO,     // undo arena
+  MEM_JOURNAL,  // swap journal batch
+  MEM_OUTPUT,   // append buffers for frames
+  MEM_WRAP,     // soft wrap layout cache
+  MEM_WATCH,    // block checksums of the file on disk
+  MEM_COLD,     // compressed blocks of rows far from the screen
+  MEM_INTERN,   // intern table and seen bitmap, outside the --mem-budget
+  MEM_COUNT
+};
+
+// live tally for one tag, sizes as the allocator really hands them out
+struct editorMemStat
+{
+  size_t bytes;  // usable bytes currently allocated
+  size_t blocks; // blocks currently allocated
+  size_t allocs; // malloc / realloc calls ever made
+};
+
+// what the latency histograms time
+enum editorStat
+{
+  STAT_KEY = 0, // key read to the frame showing it painted
+  STAT_DRAW,    // editorRefreshScreen
+  STAT_SYNTAX,  // editorUpdateSyntax, including the rows it cascades into
+  STAT_FIND,    // one search step
+  STAT_COUNT
+};
+
+#define STATS_SUB_BITS 4 // 16 linear buckets per power of two, ~6% precision
+#define STATS_BUCKETS (64 << STATS_SUB_BITS)
+
+/**
+ * HDR style log-linear histogram of nanosecond timings: values under 32
+ * get a bucket each, above that every power of two is split into 16
+ * equal buckets. Recording is a couple of shifts and an increment.
+ */
+struct editorHistogram
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint32_t buckets[STATS_BUCKETS];
+};
+
+struct editorStats
+{
+  struct editorHistogram hist[STAT_COUNT];
+  uint64_t key_ns; // when the last key came in, 0 once it's been painted
+  int overlay;     // show p50/p99 in the status bar
+};
+
+// one begin or end event in the trace ring
+typedef struct traceEvent
+{
+  const char *name; // static string, never freed
+  uint64_t ns;
+  size_t arg; // row index, SIZE_MAX for none
+  char ph;    // 'B' or 'E' as in the Chrome trace format
+} traceEvent;
+
+/**
+ * --trace: begin / end events for the expensive operations go into a
+ * fixed ring, the oldest are overwritten, and the ring is written out
+ * as Chrome trace JSON when the editor exits
+ */
+struct editorTrace
+{
+  traceEvent *ring; // NULL when tracing is off
+  size_t cap;
+  size_t count; // events ever recorded, ring slot is count % cap
+  char *path;
+  uint64_t start_ns;
+};
+
+/**
+ * Where finished frames go - the terminal normally, or the in-memory
+ * virtual terminal when the benchmark is measuring the draw path
+ */
+struct editorOutput
+{
+  void (*write)(void *ctx, const char *buf, size_t len);
+  void *ctx;
+};
+
+/**
+ * inotify watch on the open file's directory (so editors and log
+ * rotation that rename a new file into place are seen too), plus
+ * checksums of the file as we last read or wrote it, taken per block
+ * from the start and per block from the end. Comparing them with the
+ * new file's finds the unchanged head and tail, only the rows in
+ * between are reloaded.
+ */
+struct editorWatch
+{
+  int fd;      // inotify instance, -1 when not watching
+  char *name;  // file name within the watched directory
+  size_t size; // length of the file the sums describe
+  uint64_t *head; // checksum of each block counting from the start
+  uint64_t *tail; // ...and counting back from the end
+  size_t nblocks;
+  int changed;         // events came in, reload once they settle
+  uint64_t changed_ms; // when the last one came in
+};
+
+/**
+ * Follow mode (Ctrl-O or --follow), like less +F: bytes appended to
+ * the file are read once per idle tick and loaded as new rows at the
+ * end, so a fast writer costs one batch and one redraw per frame.
+ */
+struct editorFollow
+{
+  int fd;       // the file being followed, -1 when not following
+  off_t offset; // bytes of it already in the buffer
+  int partial;  // the last row is a line still waiting for its newline
+};
+
+// --view pager state, see editorViewOpen
+struct editorView
+{
+  int active;
+  char *map;       // the whole file, read-only
+  size_t len;
+  size_t *index;   // offset of every KILO_VIEW_STRIDE-th row
+  size_t nindex;
+  size_t cap;
+  size_t rows;     // rows found so far
+  size_t scanned;  // offset just after the last of them
+  int eof;         // every row has been found, 'rows' is the total
+  size_t top;      // row on the first screen line, E.row holds just the screen
+  int more;        // there are rows below the screen
+  char *query;     // last search, for 'n'
+  struct editorGz *gz; // viewing a .gz, bytes come inflated through editorViewBytes
+};
+
+// one cursor, the primary one lives in E.cx / E.cy
+typedef struct editorCursor
+{
+  size_t cy;
+  size_t cx;
+  int primary;
+} editorCursor;
+
+// Ctrl-B drops an anchor, the selection runs from it to the cursor
+struct editorSelection
+{
+  int active;
+  size_t cy, cx; // the anchor
+};
+
+/**
+ * A piece of one row on the clipboard. It holds a reference to the
+ * row's text rather than a copy, the text can't change under it since
+ * shared text is copied before it's edited.
+ */
+typedef struct clipSpan
+{
+  char *text;  // referenced row text
+  size_t off;  // where the copied part starts
+  size_t len;
+  int whole;   // the whole row, can be pasted as a row of its own
+  int cont;    // the row ran on into the next without a newline
+} clipSpan;
+
+/**
+ * What one copy put on the clipboard. It's refcounted: the undo records
+ * of pastes and cuts hold it too, so they can put the rows back without
+ * a copy of their text.
+ */
+typedef struct clipData
+{
+  int refs;
+  size_t n;
+  size_t bytes;
+  clipSpan spans[]; // one per row, a newline between each unless cont
+} clipData;
+
+struct editorClipboard
+{
+  clipData *data; // NULL while empty
+};
+
+/**
+ * Text of an OP_PASTE / OP_CUT: the end of the range pasted or cut, and
+ * in the undo arena the clipboard it came from (a reference). The swap
+ * file only gets the range, recovery pastes its own rebuilt clipboard.
+ */
+typedef struct clipOp
+{
+  size_t y1, x1;
+  clipData *clip;
+} clipOp;
+
+// one interned row text, the hash is kept here so probing doesn't touch the text
+typedef struct internSlot
+{
+  char *chars; // NULL if the slot is free
+  uint32_t len;
+  uint32_t hash;
+  struct rowShape *shape; // render / hl for the rows holding it
+} internSlot;
+
+// identical rows share one text, see editorTextIntern
+struct editorIntern
+{
+  uint64_t *seen;    // bitmap of hashes of row texts inserted so far
+  size_t seen_bits;  // a power of two, KILO_INTERN_SEEN once it's grown
+  size_t nseen;      // bits set in it
+  internSlot *slots; // open addressing on the hash
+  size_t cap;        // a power of two
+  size_t n;
+  size_t hits;       // rows that found their text already there
+};
+
+// one block kept decompressed, see editorColdRaw
+struct editorColdCache
+{
+  struct coldBlock *blk; // NULL if the slot is free
+  char *raw;
+  size_t cap;
+};
+
+// --mem-budget: rows far from the screen are kept compressed, see editorColdPoll
+struct editorCold
+{
+  size_t budget; // bytes of text, render and hl to stay under, 0 if off
+  size_t hand;   // row the next freeze starts looking at
+  size_t swept;  // rows looked at since the last freeze
+  size_t full;   // usage when a whole pass found nothing to freeze
+  struct editorColdCache cache[KILO_COLD_CACHE];
+  int next;      // cache slot reused next
+  size_t blocks; // blocks alive
+  size_t rows;   // rows frozen in them
+  size_t raw;    // bytes their text takes uncompressed
+  size_t hits;   // reads of frozen text the cache had
+  size_t misses; // ...and ones that had to decompress a block
+};
+
+// --render-budget: render / hl of rows not looked at lately are dropped, see editorEvictPoll
+struct editorEvict
+{
+  size_t budget;  // bytes of render and hl to stay under, 0 if off
+  size_t hand;    // row the clock looks at next
+  size_t swept;   // rows looked at since the last eviction
+  size_t full;    // usage when two whole passes found nothing to drop
+  size_t evicted; // rows whose render was dropped
+  size_t rebuilt; // ...and rendered again when they were next needed
+};
 
 // global struct to contain editor's state
 struct editorConfig
 {
   // cursor position
-  int cx, cy;
-  int rx;     // horizontal co-ordinate for tabs e.t.c
-  int rowoff; // vertical scrolling
-  int coloff; // horizontal scrolling
+  size_t cx, cy;
+  size_t rx;     // horizontal co-ordinate for tabs e.t.c
+  size_t rowoff; // vertical scrolling
+  size_t coloff; // horizontal scrolling
   int screenrows;
   int screencols;
-  int numrows;
+  size_t numrows;
   erow *row; // storing multiple lines
+  rowDisplay *display; // render / hl of each of them, see erow
   int dirty;
+  size_t dirty_row; // first row changed since the last save / load, SIZE_MAX if none
+  size_t dirty_col; // first changed byte within dirty_row
+  int safe_save;    // --safe-save: always write a temp file and rename it over
+  int disk_exact;   // file on disk is byte for byte what editorRowsFill gives
+  int gzip;         // the file is gzip compressed, it's saved compressed too
   char *filename;     // adding filename for status bar
   char statusmsg[80]; // creating status message line under status bar
   struct editorSyntax *syntax;
   time_t statusmsg_time; // current time of the status msg
+  struct editorUndo undo; // undo / redo history
+  struct editorJournal journal; // swap file for crash recovery
+  struct editorWrap wrap;       // soft wrap display mode
+  int record_fd;                // --record: raw input bytes are copied here, -1 if off
+  struct editorOutput out;      // frame sink, the terminal unless benchmarking
+  struct editorStats stats;     // latency histograms
+  struct editorTrace trace;     // --trace event recorder
+  struct editorMemStat mem[MEM_COUNT]; // memory per subsystem
+  int batch;                    // --batch: no terminal, rows are never rendered
+  int prompting;                // a prompt is open, its callback may hold row numbers
+  editorCursor *cursors;        // extra cursors added with Ctrl-N
+  size_t ncursors;
+  struct editorSelection sel;   // Ctrl-B mark
+  struct editorClipboard clip;  // Ctrl-C / Ctrl-X / Ctrl-V
+  struct editorWatch watch;     // reload when the file changes on disk
+  struct editorFollow follow;   // tail the file as it grows
+  struct editorView view;       // --view read-only pager
+  struct editorIntern intern;   // duplicate rows share text, render and hl
+  struct editorCold cold;       // rows away from the screen compressed under a memory budget
+  struct editorEvict evict;     // render / hl of rows not used lately dropped under a budget
 
   struct termios orig_termios; // Saving original termios state
 };
 
 struct editorConfig E;
 
+// set by the SIGWINCH handler, picked up before the next refresh
+volatile sig_atomic_t winch = 0;
+
 /*** filetypes ***/
 
 // Checking for different file type extensions
@@ -130,1606 +581,8939 @@ struct editorSyntax HLDB[] = {
 #define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
 
 /*** PROTOTYPES ***/
+void die(const char *s);
 void editorSetStatusMessage(const char *fmt, ...);
 void editorRefreshScreen();
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
+char *editorPromptRead(char *prompt, void (*callback)(char *, int), int allow_empty);
+void editorRecordOp(int type, size_t row, size_t col, const char *s, size_t len);
+void editorJournalOp(int type, size_t row, size_t col, const char *s, size_t len);
+void editorClipRelease(struct clipData *clip);
+void editorClipSetRange(size_t y0, size_t x0, size_t y1, size_t x1);
+void editorClipFromText(const char *text, size_t len);
+void editorClipOp(int type, struct clipData *clip, size_t y0, size_t x0, size_t y1, size_t x1);
+void editorJournalFlush(int force);
+void editorJournalDiscard();
+void editorJournalRecover();
+void editorJournalStamp(const char *filename);
+void editorIdle();
+void editorWrapInvalidate();
+void editorWrapSplice(size_t at, size_t del, size_t ins);
+void editorWrapRowChanged(erow *row);
+void editorUpdateSyntax(erow *row);
+void editorUpdateRow(erow *row);
+void editorMoveCursor(int key);
+void editorWatchStart(const char *map, size_t len);
+void editorWatchSaved();
+void editorFollowPoll();
+int editorSelectionKeeps(int c);
+void editorViewFill(size_t top);
+void editorCursorsClear();
+int editorSelectionRowRange(erow *row, size_t *rb0, size_t *rb1);
+#ifdef KILO_ZLIB
+struct lineLoader;
+int editorIsGzip(const char *filename);
+ssize_t editorGzScan(const char *filename, struct lineLoader *ld, size_t index_from);
+int editorGzSave();
+#endif
+#ifdef KILO_BENCH
+extern int bench_replay;
+int editorBenchReadByte(char *c);
+void editorBenchMark();
+int editorBenchMain(int argc, char **argv);
+#endif
+
+/*** memory accounting ***/
 
-/*** terminal ***/
-void die(const char *s)
+/**
+ * Tagged allocation wrappers - each subsystem allocates through these
+ * so the live bytes per tag can be shown. Counting uses
+ * malloc_usable_size so allocator rounding is included, a block must be
+ * freed with the tag it was allocated with.
+ */
+void *editorMalloc(int tag, size_t size)
 {
-  // clear screen on exit
-  write(STDOUT_FILENO, "\x1b[2J", 4);
-  write(STDOUT_FILENO, "\x1b[H", 3);
+  void *p = malloc(size);
+  if (p)
+  {
+    E.mem[tag].bytes += malloc_usable_size(p);
+    E.mem[tag].blocks++;
+  }
+  E.mem[tag].allocs++;
+  return p;
+}
 
-  perror(s); // prints string given to it before error occured
-  exit(1);
+// zeroed, big blocks come straight from the kernel so untouched pages cost nothing
+void *editorCalloc(int tag, size_t n, size_t size)
+{
+  void *p = calloc(n, size);
+  if (p)
+  {
+    E.mem[tag].bytes += malloc_usable_size(p);
+    E.mem[tag].blocks++;
+  }
+  E.mem[tag].allocs++;
+  return p;
 }
 
-void disableRawMode()
+void *editorRealloc(int tag, void *ptr, size_t size)
 {
-  // If we can't disable raw mode, exit
-  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
+  size_t old = ptr ? malloc_usable_size(ptr) : 0;
+  void *p = realloc(ptr, size);
+  if (p == NULL && size)
   {
-    die("tcsetattr");
+    return NULL; // ptr is untouched
+  }
+  if (ptr)
+  {
+    E.mem[tag].bytes -= old;
+    E.mem[tag].blocks--;
+  }
+  if (p)
+  {
+    E.mem[tag].bytes += malloc_usable_size(p);
+    E.mem[tag].blocks++;
   }
+  E.mem[tag].allocs++;
+  return p;
 }
 
-/**
- * Function to modify struct variables / flags
- * all of these variables / objects come from termios.h
- */
-void enableRawMode()
+void editorFree(int tag, void *ptr)
 {
-  if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1)
+  if (ptr)
   {
-    // if we can' get the raw mode attributes, exit
-    die("tcgetattr");
-  } // Save struct to orig_termios var
+    E.mem[tag].bytes -= malloc_usable_size(ptr);
+    E.mem[tag].blocks--;
+    free(ptr);
+  }
+}
 
-  atexit(disableRawMode); // at exit, disable the raw mode
+// 512B, 12K, 3.4M, 1.2G
+void editorMemFormat(char *buf, size_t size, size_t bytes)
+{
+  const char *units = "BKMGT";
+  double v = bytes;
+  int u = 0;
+  while (v >= 1024 && u < 4)
+  {
+    v /= 1024;
+    u++;
+  }
+  snprintf(buf, size, v < 10 && u ? "%.1f%c" : "%.0f%c", v, units[u]);
+}
 
-  struct termios raw = E.orig_termios;
+static const char *mem_names[MEM_COUNT] = {"rows", "text", "render", "hl", "search", "undo", "journal", "output", "wrap", "watch", "cold", "intern"};
 
-  // Disabling ctrl-s & ctrl-q - input types
-  raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+// Ctrl-G: the non-empty tags in the message bar, biggest use first
+void editorMemShow()
+{
+  int order[MEM_COUNT];
+  size_t total = 0;
+  for (int i = 0; i < MEM_COUNT; i++)
+  {
+    order[i] = i;
+    total += E.mem[i].bytes;
+  }
+  for (int i = 1; i < MEM_COUNT; i++)
+  {
+    for (int j = i; j > 0 && E.mem[order[j]].bytes > E.mem[order[j - 1]].bytes; j--)
+    {
+      int t = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = t;
+    }
+  }
 
-  // disabling output processing
-  raw.c_oflag &= ~(OPOST);
+  char msg[80], size[16];
+  editorMemFormat(size, sizeof(size), total);
+  int len = snprintf(msg, sizeof(msg), "mem %s:", size);
+  if (E.cold.hits + E.cold.misses)
+  {
+    // how often reading a frozen row found its block already decompressed
+    len = snprintf(msg, sizeof(msg), "mem %s (cold %zu%% hit):", size, E.cold.hits * 100 / (E.cold.hits + E.cold.misses));
+  }
+  for (int i = 0; i < MEM_COUNT && E.mem[order[i]].bytes && (size_t)len < sizeof(msg); i++)
+  {
+    editorMemFormat(size, sizeof(size), E.mem[order[i]].bytes);
+    len += snprintf(msg + len, sizeof(msg) - len, " %s %s", mem_names[order[i]], size);
+  }
+  editorSetStatusMessage("%s", msg);
+}
 
-  // Bit mask with multiple bits ( | = bitwise OR )
-  raw.c_cflag |= (CS8);
+// full breakdown for the stats dump
+void editorMemDump(FILE *fp)
+{
+  size_t total = 0;
+  fprintf(fp, "\nmemory: tag bytes blocks allocs\n");
+  for (int i = 0; i < MEM_COUNT; i++)
+  {
+    fprintf(fp, "  %-8s %zu %zu %zu\n", mem_names[i], E.mem[i].bytes, E.mem[i].blocks, E.mem[i].allocs);
+    total += E.mem[i].bytes;
+  }
+  fprintf(fp, "  total    %zu\n", total);
+
+  // row array capacity not holding a row
+  size_t used = E.numrows * (sizeof(erow) + sizeof(rowDisplay));
+  size_t cap = E.row ? malloc_usable_size(E.row) + malloc_usable_size(E.display) : 0;
+  fprintf(fp, "  rows slack %zu (%zu rows of %zu + %zu bytes)\n", cap > used ? cap - used : 0, E.numrows,
+          sizeof(erow), sizeof(rowDisplay));
+  fprintf(fp, "  interned %zu texts, %zu rows reused one\n", E.intern.n, E.intern.hits);
+  fprintf(fp, "  cold %zu rows in %zu blocks, %zu bytes compressed to %zu, cache %zu hits %zu misses\n",
+          E.cold.rows, E.cold.blocks, E.cold.raw, E.mem[MEM_COLD].bytes, E.cold.hits, E.cold.misses);
+  fprintf(fp, "  render dropped from %zu rows, rebuilt for %zu\n", E.evict.evicted, E.evict.rebuilt);
+}
 
-  // Read input byte-by-byte, not line-by-line
-  // Turn off canonical mode
-  // turn off Ctrl-c and ctrl-z signals
-  raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
-  // ~ (BITWISE NOT) > from 0010 to 1101
-  // & (BITWISE AND) > from 0010 to 0000
-  /*
-    BITWISE AND
-    0  0  >  0
-    0  1  >  0
-    1  0  >  0
-    1  1  >  1
-    */
+/*** shared row text ***/
 
-  // c.cc = control characters - array of bytes with terminal settings
-  raw.c_cc[VMIN] = 0;  // num bytes before read can return
-  raw.c_cc[VTIME] = 1; // max time to wait before read returns (100mS)
+/**
+ * Row chars live in refcounted blocks so a row's text can be shared
+ * (e.g. by the clipboard) without copying it. row->chars points at the
+ * data, readers don't need to know. A shared block is never written to,
+ * anything that changes a row's text calls editorTextOwn first and gets
+ * its own copy if someone else still holds a reference.
+ *
+ * Rows inserted whole (loading, pasting, undo) are interned: a row
+ * whose text is already held by another row takes a reference to that
+ * block instead, so a log with a million identical heartbeat lines
+ * keeps one copy of it. A text goes in the intern table the second time
+ * it's seen (a bitmap of hashes remembers the first), so rows seen once
+ * never get a table entry. The bitmap is 128KB, and a fixed 4MB once
+ * a file has more than 32K distinct rows. Once
+ * more than one row holds an interned text, the first of them to be
+ * rendered hands its render, checkpoints and highlight to a rowShape
+ * kept with it and the rest just point at them. Editing a row gives it
+ * its own text (and the next editorUpdateRow its own render), so only
+ * unmodified rows share.
+ */
+typedef struct rowText
+{
+  uint32_t refs;
+  uint32_t hash; // of the contents while interned, 0 if it isn't
+  char data[];
+} rowText;
 
-  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1)
+/**
+ * Render and highlight built once for an interned text held by more
+ * than one row. Highlighting depends on whether the row starts inside
+ * a multi-line comment, so there's one for each. Held by the text's
+ * table entry and by each row using it.
+ */
+typedef struct rowShape
+{
+  size_t refs;
+  char *render;  // NULL until a row has been rendered
+  size_t rsize;
+  size_t rwidth;
+  rowCheckpoint *cp;
+  size_t ncp;
+  int ascii;
+  unsigned char *hl[2]; // starting outside / inside a comment
+  int hl_open[2];       // hl_open_comment each of them leaves
+  struct editorSyntax *syntax; // what hl was made with
+} rowShape;
+
+#define ROW_TEXT(chars) ((rowText *)((chars) - offsetof(rowText, data)))
+
+uint64_t editorBlockSum(const char *p, size_t len);
+
+// new unshared text with room for 'cap' bytes
+char *editorTextAlloc(size_t cap)
+{
+  rowText *t = editorMalloc(MEM_TEXT, sizeof(rowText) + cap);
+  if (t == NULL)
   {
-    // if we can't set the new attributes, exit
-    die("tcsetattr");
-  } // setting attrbiute
-  // TCASFLUSH - specifies when to apply change, here we wait until output to be written to terminal
+    die("malloc");
+  }
+  t->refs = 1;
+  t->hash = 0;
+  return t->data;
 }
 
-// wait for a key press and return it
-int editorReadKey()
+char *editorTextRef(char *chars)
 {
-  int nread;
-  char c;
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1)
+  ROW_TEXT(chars)->refs++;
+  return chars;
+}
+
+void editorShapeRelease(rowShape *sh)
+{
+  if (sh && --sh->refs == 0)
   {
-    if (nread == -1 && errno != EAGAIN)
-    {
-      die("read");
-    }
+    editorFree(MEM_RENDER, sh->render);
+    editorFree(MEM_RENDER, sh->cp);
+    editorFree(MEM_HL, sh->hl[0]);
+    editorFree(MEM_HL, sh->hl[1]);
+    editorFree(MEM_RENDER, sh);
   }
+}
 
-  if (c == '\x1b')
+// table entry of an interned text
+internSlot *editorInternFind(rowText *t)
+{
+  size_t mask = E.intern.cap - 1;
+  size_t i = t->hash & mask;
+  while (E.intern.slots[i].chars != t->data)
   {
+    i = (i + 1) & mask;
+  }
+  return &E.intern.slots[i];
+}
 
-    char seq[3];
-
-    if (read(STDIN_FILENO, &seq[0], 1) != 1)
+// take a text out of E.intern, rows keep the shape they already use
+void editorTextUnintern(rowText *t)
+{
+  size_t mask = E.intern.cap - 1;
+  internSlot *sl = editorInternFind(t);
+  editorShapeRelease(sl->shape);
+  memset(sl, 0, sizeof(*sl));
+  E.intern.n--;
+  // close the gap so later entries of the same run are still found
+  size_t i = sl - E.intern.slots;
+  for (size_t j = (i + 1) & mask; E.intern.slots[j].chars; j = (j + 1) & mask)
+  {
+    size_t home = E.intern.slots[j].hash & mask;
+    if (((j - home) & mask) >= ((j - i) & mask))
     {
-      return '\x1b';
+      E.intern.slots[i] = E.intern.slots[j];
+      memset(&E.intern.slots[j], 0, sizeof(internSlot));
+      i = j;
     }
-    if (read(STDIN_FILENO, &seq[1], 1) != 1)
+  }
+  t->hash = 0;
+}
+
+void editorTextRelease(char *chars)
+{
+  if (chars && --ROW_TEXT(chars)->refs == 0)
+  {
+    rowText *t = ROW_TEXT(chars);
+    if (t->hash)
     {
-      return '\x1b';
+      editorTextUnintern(t);
     }
+    editorFree(MEM_TEXT, t);
+  }
+}
 
-    // replacing up|down|left|right arrows with WASD
-    if (seq[0] == '[')
+// double the intern table, it's kept at most 3/4 full
+void editorInternGrow()
+{
+  size_t oldcap = E.intern.cap;
+  internSlot *old = E.intern.slots;
+  E.intern.cap = oldcap ? oldcap * 2 : 1024;
+  E.intern.slots = editorCalloc(MEM_INTERN, E.intern.cap, sizeof(internSlot));
+  if (E.intern.slots == NULL)
+  {
+    die("calloc");
+  }
+  size_t mask = E.intern.cap - 1;
+  for (size_t i = 0; i < oldcap; i++)
+  {
+    if (old[i].chars)
     {
-      if (seq[1] >= '0' && seq[1] <= '9')
+      size_t j = old[i].hash & mask;
+      while (E.intern.slots[j].chars)
       {
+        j = (j + 1) & mask;
+      }
+      E.intern.slots[j] = old[i];
+    }
+  }
+  editorFree(MEM_INTERN, old);
+}
 
-        if (read(STDIN_FILENO, &seq[2], 1) != 1)
-        {
-          return '\x1b';
-        }
+/**
+ * The seen bitmap starts small so a short file doesn't fault in 4MB of
+ * it, and goes to full size once it's filling up. A bit's index is the
+ * low bits of the hash, so in the bigger bitmap it's at the same place
+ * in one of the copies of the small one: every copy starts as the small
+ * bitmap and nothing seen is forgotten.
+ */
+void editorInternGrowSeen()
+{
+  size_t bits = E.intern.seen_bits ? KILO_INTERN_SEEN : KILO_INTERN_SEEN / 32;
+  uint64_t *seen = editorCalloc(MEM_INTERN, bits / 64, sizeof(uint64_t));
+  if (seen == NULL)
+  {
+    die("calloc");
+  }
+  for (size_t i = 0; E.intern.seen && i < bits / 64; i += E.intern.seen_bits / 64)
+  {
+    memcpy(&seen[i], E.intern.seen, E.intern.seen_bits / 8);
+  }
+  editorFree(MEM_INTERN, E.intern.seen);
+  E.intern.seen = seen;
+  E.intern.seen_bits = bits;
+}
 
-        // if byte after [ is a digit
-        // read another byte expecting ~
-        // See if digit byte was 5 or 6
-        if (seq[2] == '~')
-        {
-          switch (seq[1])
-          {
-          case '1':
-            return HOME_KEY;
-          case '3':
-            return DEL_KEY;
-          case '4':
-            return END_KEY;
-          case '5':
-            return PAGE_UP;
-          case '6':
-            return PAGE_DOWN;
-          case '7':
-            return HOME_KEY;
-          case '8':
-            return END_KEY;
-          }
-        }
-      }
-      else
-      {
-        switch (seq[1])
-        {
-        case 'A':
-          return ARROW_UP;
-        case 'B':
-          return ARROW_DOWN;
-        case 'C':
-          return ARROW_RIGHT;
-        case 'D':
-          return ARROW_LEFT;
-        case 'H':
-          return HOME_KEY;
-        case 'F':
-          return END_KEY;
-        }
-      }
-    }
-    else if (seq[0] == 'O')
-    {
-      switch (seq[1])
-      {
-      case 'H':
-        return HOME_KEY;
-      case 'F':
-        return END_KEY;
-      }
-    }
-    return '\x1b';
+/**
+ * The interned text with the same contents as 'chars' (len bytes),
+ * which is released if there already is one. Takes over the reference.
+ */
+char *editorTextIntern(char *chars, size_t len)
+{
+  rowText *t = ROW_TEXT(chars);
+  if (t->hash || len > UINT32_MAX)
+  {
+    return chars; // already in, or too long to be worth looking for
   }
-  else
+  if (E.intern.nseen >= E.intern.seen_bits / 32 && E.intern.seen_bits < KILO_INTERN_SEEN)
   {
-    return c;
+    editorInternGrowSeen();
   }
-}
-
-int getCursorPosition(int *rows, int *cols)
-{
 
-  char buf[32];
-  unsigned int i = 0;
-
-  // 'n' is device status report command - finding cursor pos
-  // https://vt100.net/docs/vt100-ug/chapter3.html#DSR
-  if (write(STDOUT_FILENO, "\x1b[6n", 4) != 4)
+  // first time these contents are seen, nothing to share with yet
+  uint64_t sum = editorBlockSum(chars, len);
+  size_t bit = (sum >> 32) & (E.intern.seen_bits - 1);
+  if (!(E.intern.seen[bit / 64] & ((uint64_t)1 << (bit % 64))))
   {
-    return -1;
+    E.intern.seen[bit / 64] |= (uint64_t)1 << (bit % 64);
+    E.intern.nseen++;
+    return chars;
   }
 
-  // read in to fill the buffer - breka on 'R' character
-  while (i < sizeof(buf) - 1)
+  if (E.intern.n + 1 > E.intern.cap / 4 * 3)
   {
-    if (read(STDIN_FILENO, &buf[i], 1) != 1)
-    {
-      break;
-    }
-    if (buf[i] == 'R')
+    editorInternGrow();
+  }
+  uint32_t hash = (uint32_t)sum | 1; // 0 means not interned
+  size_t mask = E.intern.cap - 1;
+  size_t i = hash & mask;
+  for (; E.intern.slots[i].chars; i = (i + 1) & mask)
+  {
+    internSlot *sl = &E.intern.slots[i];
+    if (sl->hash == hash && sl->len == len && memcmp(sl->chars, chars, len) == 0)
     {
-      break;
+      E.intern.hits++;
+      editorTextRelease(chars);
+      return editorTextRef(sl->chars);
     }
-    i++;
   }
+  E.intern.slots[i].chars = chars;
+  E.intern.slots[i].len = len;
+  E.intern.slots[i].hash = hash;
+  E.intern.n++;
+  t->hash = hash;
+  return chars;
+}
 
-  // make the final byte \0
-  buf[i] = '\0';
+// shared render / hl of an interned text, NULL if there's none yet
+rowShape *editorTextShape(char *chars)
+{
+  rowText *t = ROW_TEXT(chars);
+  return t->hash ? editorInternFind(t)->shape : NULL;
+}
 
-  // make sur eit responded with escape character
-  if (buf[0] != '\x1b' || buf[1] != '[')
+/**
+ * Make 'chars' (len bytes plus its terminator) safe to write to with
+ * room for 'cap' bytes. Copies it if it's shared, otherwise only
+ * reallocs when the block is really too small.
+ */
+char *editorTextOwn(char *chars, size_t len, size_t cap)
+{
+  rowText *t = ROW_TEXT(chars);
+  if (t->refs > 1)
   {
-    return -1;
+    char *own = editorTextAlloc(cap);
+    memcpy(own, chars, len + 1);
+    t->refs--;
+    return own;
   }
-  // pass pointer to 3rd ele of buf[]
-  if (sscanf(&buf[2], "%d;%d", rows, cols) != 2)
+  if (t->hash)
   {
-    return -1;
+    editorTextUnintern(t); // about to change, it can't be found by its old contents
   }
-
-  return 0;
+  if (malloc_usable_size(t) >= sizeof(rowText) + cap)
+  {
+    return chars;
+  }
+  t = editorRealloc(MEM_TEXT, t, sizeof(rowText) + cap);
+  if (t == NULL)
+  {
+    die("realloc");
+  }
+  return t->data;
 }
 
-// // // get the size of the terminal
-int getWindowSize(int *rows, int *cols)
+// the row's hl belongs to its shape rather than the row
+int editorRowHlShared(erow *row)
 {
+  rowDisplay *d = ROW_DISPLAY(row);
+  return d->shape && d->hl && (d->hl == d->shape->hl[0] || d->hl == d->shape->hl[1]);
+}
 
-  // ioctl(), TIOCGWINSZ, and struct winsize come from <sys/ioctl.h>.
-  struct winsize ws;
-
-  // on success, system call will place numbers of cols and rows in winsize struct
-  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0)
+// give back the render / cp / hl the row borrowed, or free its own render / cp
+void editorRowUnshare(erow *row)
+{
+  rowDisplay *d = ROW_DISPLAY(row);
+  if (d->shape)
   {
-
-    // C -> move the cursor right 999 spaces
-    // B -> move the cursor down 999 spaces
-    if (write(STDOUT_FILENO, "\x1b[999C\x1b[999B", 12) != 12)
+    if (editorRowHlShared(row))
     {
-      return -1;
+      d->hl = NULL;
     }
-    // return current current position
-    return getCursorPosition(rows, cols);
+    editorShapeRelease(d->shape);
+    d->shape = NULL;
   }
   else
   {
-    // setting the references passed to new values
-    // common way to return multiple values in C
-    *cols = ws.ws_col;
-    *rows = ws.ws_row;
-    return 0;
+    editorFree(MEM_RENDER, d->render);
+    editorFree(MEM_RENDER, d->cp);
   }
+  d->render = NULL;
+  d->cp = NULL;
 }
 
-/*** Syntax highlighting ***/
-
-int is_separator(int c)
+// a copy of a borrowed hl that can be written to (e.g. to mark a search match)
+void editorRowOwnHl(erow *row)
 {
-  // Checking if the current character is a separator character
-  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+  rowDisplay *d = ROW_DISPLAY(row);
+  if (editorRowHlShared(row))
+  {
+    unsigned char *hl = editorMalloc(MEM_HL, d->rsize ? d->rsize : 1);
+    if (hl == NULL)
+    {
+      die("malloc");
+    }
+    memcpy(hl, d->hl, d->rsize);
+    d->hl = hl;
+  }
 }
 
-void editorUpdateSyntax(erow *row)
+// first row with this text highlighted from this state, the others will use its hl
+void editorRowShareHl(erow *row, int starts_in_comment)
 {
-  // Create a new array of memory for the highlighting, same size of row
-  row->hl = realloc(row->hl, row->rsize);
-  // Set all the items in hl array to 'HL_NORMAL'
-  memset(row->hl, HL_NORMAL, row->rsize);
-
-  // There's not filetype for the current file, don't highlight syntax
-  if (E.syntax == NULL)
+  rowDisplay *d = ROW_DISPLAY(row);
+  rowShape *sh = d->shape;
+  if (sh && d->rsize && sh->hl[starts_in_comment] == NULL &&
+      (sh->syntax == E.syntax || (sh->hl[0] == NULL && sh->hl[1] == NULL)))
   {
-    return;
+    sh->hl[starts_in_comment] = d->hl;
+    sh->hl_open[starts_in_comment] = row->hl_open_comment;
+    sh->syntax = E.syntax;
   }
+}
 
-  char **keywords = E.syntax->keywords;
-
-  char *scs = E.syntax->singleline_comment_start;
-  char *mcs = E.syntax->multiline_comment_start;
-  char *mce = E.syntax->multiline_comment_end;
+/*** cold rows ***/
 
-  int scs_len = scs ? strlen(scs) : 0;
-  int mcs_len = mcs ? strlen(mcs) : 0;
-  int mce_len = mce ? strlen(mce) : 0;
+/**
+ * --mem-budget (or KILO_MEM_BUDGET): once row text, render and hl
+ * together pass the budget, rows far from the screen are frozen a block
+ * at a time. Their text is packed into one buffer and compressed, their
+ * render, checkpoints and hl are dropped. A frozen row keeps its size,
+ * width and hl_open_comment, so soft wrap and the comment state of the
+ * rows after it don't need it. Anything that reads the text goes
+ * through editorRowText, anything that needs more calls editorRowWarm,
+ * which gives the row its text back and renders it again. The last few
+ * blocks read are kept decompressed, reads tend to be of neighbours.
+ * Rows whose text is shared (with identical rows or the clipboard)
+ * aren't frozen, there's only one copy of it anyway.
+ */
+typedef struct coldBlock
+{
+  size_t rows; // rows still frozen in it
+  size_t raw;  // bytes once decompressed
+  size_t zlen;
+  char data[];
+} coldBlock;
 
-  // making sure the ints in the middle of a word are not hihglighted.
-  int prev_sep = 1;
-  int in_string = 0;
-  int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment); // Better way to check we're in a multi-line comment
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
 
-  int i = 0;
-  // Go through all itmes in row
+// a literal or match length past what fits in the token, 255 at a time
+int editorLzLength(unsigned char **o, unsigned char *end, size_t len)
+{
+  while (len >= 255)
+  {
+    if (*o == end)
+    {
+      return 0;
+    }
+    *(*o)++ = 255;
+    len -= 255;
+  }
+  if (*o == end)
+  {
+    return 0;
+  }
+  *(*o)++ = len;
+  return 1;
+}
 
-  // whikle loop allows for multiple characters each function call
-  while (i < row->rsize)
+/**
+ * One sequence: a token (literal count in the high nibble, match length
+ * less LZ_MIN_MATCH in the low one, 15 meaning more bytes follow), the
+ * literals, then the match's 2 byte offset back. The last sequence is
+ * just literals. Returns 0 if it doesn't fit before 'end'.
+ */
+int editorLzSequence(unsigned char **o, unsigned char *end, const unsigned char *lit, size_t nlit, size_t off, size_t mlen)
+{
+  if (*o == end)
+  {
+    return 0;
+  }
+  size_t mcode = mlen ? mlen - LZ_MIN_MATCH : 0;
+  *(*o)++ = ((nlit < 15 ? nlit : 15) << 4) | (mcode < 15 ? mcode : 15);
+  if (nlit >= 15 && !editorLzLength(o, end, nlit - 15))
+  {
+    return 0;
+  }
+  if ((size_t)(end - *o) < nlit)
+  {
+    return 0;
+  }
+  memcpy(*o, lit, nlit);
+  *o += nlit;
+  if (mlen == 0)
+  {
+    return 1;
+  }
+  if (end - *o < 2)
   {
-    char c = row->render[i];
-    unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+    return 0;
+  }
+  *(*o)++ = off & 0xff;
+  *(*o)++ = off >> 8;
+  return mcode < 15 || editorLzLength(o, end, mcode - 15);
+}
 
-    if (scs_len && !in_string && !in_comment)
+/**
+ * LZ77 in the style of LZ4: greedy matches of 4 bytes or more within
+ * the last 64K, found through a hash of the next 4 bytes. Not the best
+ * ratio, but row text compresses well enough and both ways are fast.
+ * Returns the compressed size, 0 if it doesn't fit in 'cap'.
+ */
+size_t editorLzCompress(const char *src, size_t n, char *dst, size_t cap)
+{
+  uint32_t table[1 << LZ_HASH_BITS]; // last position + 1 of 4 bytes with this hash
+  memset(table, 0, sizeof(table));
+  const unsigned char *s = (const unsigned char *)src;
+  unsigned char *o = (unsigned char *)dst;
+  unsigned char *end = o + cap;
+  size_t anchor = 0; // first byte not yet written out
+  size_t i = 0;
+  while (i + LZ_MIN_MATCH <= n)
+  {
+    uint32_t seq;
+    memcpy(&seq, &s[i], 4);
+    uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+    size_t cand = table[h];
+    table[h] = i + 1;
+    if (cand == 0 || i - (cand - 1) > 0xffff || memcmp(&s[cand - 1], &s[i], LZ_MIN_MATCH) != 0)
     {
-      // check if char is the start of single line comment
-      if (!strncmp(&row->render[i], scs, scs_len))
-      {
-        memset(&row->hl[i], HL_COMMENT, row->rsize - i);
-        break;
-      }
+      i++;
+      continue;
+    }
+    cand--;
+    size_t len = LZ_MIN_MATCH;
+    while (i + len < n && s[cand + len] == s[i + len])
+    {
+      len++;
     }
+    if (!editorLzSequence(&o, end, &s[anchor], i - anchor, i - cand, len))
+    {
+      return 0;
+    }
+    i += len;
+    anchor = i;
+  }
+  if (!editorLzSequence(&o, end, &s[anchor], n - anchor, 0, 0))
+  {
+    return 0;
+  }
+  return o - (unsigned char *)dst;
+}
 
-    if (mcs_len && mce_len && !in_string)
+// exactly 'raw' bytes out of 'n' compressed ones, -1 if they don't make sense
+int editorLzDecompress(const char *src, size_t n, char *dst, size_t raw)
+{
+  const unsigned char *s = (const unsigned char *)src;
+  const unsigned char *send = s + n;
+  unsigned char *o = (unsigned char *)dst;
+  unsigned char *oend = o + raw;
+  while (s < send)
+  {
+    unsigned char token = *s++;
+    size_t lit = token >> 4;
+    if (lit == 15)
     {
-      if (in_comment)
+      unsigned char b;
+      do
       {
-        row->hl[i] = HL_MLCOMMENT;
-        if (!strncmp(row->render[i], mce, mce_len)) 
-        {
-          // if we're at the end of the multiline comment, finish highlighting and continue
-          memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-          i += mce_len;
-          in_comment = 0;
-          prev_sep = 1;
-          continue;
-        }
-        else if (!strncmp(&row->render[i], mcs, mcs_len))
+        if (s == send)
         {
-          // If we've just entered the Multiline comment, swap the variables to show this
-          memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
-          i += mcs_len;
-          in_comment = 1;
-          continue;
+          return -1;
         }
-      }
+        b = *s++;
+        lit += b;
+      } while (b == 255);
+    }
+    if ((size_t)(send - s) < lit || (size_t)(oend - o) < lit)
+    {
+      return -1;
+    }
+    memcpy(o, s, lit);
+    o += lit;
+    s += lit;
+    if (s == send)
+    {
+      break; // the last sequence has no match
     }
 
-    if (E.syntax->flags & HL_HIGHLIGHT_STRINGS)
+    if (send - s < 2)
     {
-      if (in_string)
-      {
-        row->hl[i] = HL_STRING;
-        // If we're in a string, and there's a \, we know there's another few characters on next row that nned highlight
-        if (c == '\\' && i + 1 < row->rsize)
-        {
-          row->hl[i + 1] = HL_STRING;
-          i += 2;
-          continue;
-        }
-        if (c == in_string)
-        {
-          in_string = 0;
-        }
-        i++;
-        prev_sep = 1;
-        continue;
-      }
-      else
+      return -1;
+    }
+    size_t off = s[0] | (s[1] << 8);
+    s += 2;
+    size_t mlen = token & 15;
+    if (mlen == 15)
+    {
+      unsigned char b;
+      do
       {
-        // highlighting double and single quote string
-        if (c == '"' || c == '\'')
+        if (s == send)
         {
-          in_string = c;
-          row->hl[i] = HL_STRING;
-          i++;
-          continue;
+          return -1;
         }
-      }
+        b = *s++;
+        mlen += b;
+      } while (b == 255);
     }
-
-    if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS)
+    mlen += LZ_MIN_MATCH;
+    if (off == 0 || off > (size_t)(o - (unsigned char *)dst) || (size_t)(oend - o) < mlen)
     {
-      // If the item is a digit & allowing for decimal points
-      if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
-          (c == '.' && prev_hl == HL_NUMBER))
-      {
-        // set the highlight array in same position to number highlight
-        row->hl[i] = HL_NUMBER;
-        i++;
-        prev_sep = 0;
-        continue;
-      }
+      return -1;
+    }
+    // byte at a time, a match may overlap the bytes it's producing
+    const unsigned char *m = o - off;
+    while (mlen--)
+    {
+      *o++ = *m++;
     }
+  }
+  return o == oend ? 0 : -1;
+}
 
-    if (prev_sep)
+// memory the budget is about
+size_t editorColdUsed()
+{
+  return E.mem[MEM_TEXT].bytes + E.mem[MEM_RENDER].bytes + E.mem[MEM_HL].bytes + E.mem[MEM_COLD].bytes;
+}
+
+// a block's text decompressed, from the cache if it's one of the last few read
+const char *editorColdRaw(coldBlock *blk)
+{
+  for (int i = 0; i < KILO_COLD_CACHE; i++)
+  {
+    if (E.cold.cache[i].blk == blk)
     {
-      int j;
-      for (j = 0; keywords[j]; j++)
-      {
-        int klen = strlen(keywords[j]);
-        int kw2 = keywords[j][klen - 1] == '|';
-        if (kw2)
-        {
-          klen--;
-        }
-        if (!strncmp(&row->render[i], keywords[j], klen) &&
-            is_separator(row->render[i + klen]))
-        {
-          memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-          i += klen;
-          break;
-        }
-      }
-      if (keywords[j] != NULL)
-      {
-        prev_sep = 0;
-        continue;
-      }
+      E.cold.hits++;
+      return E.cold.cache[i].raw;
     }
+  }
+  E.cold.misses++;
 
-    // checking if previous step was separator so we don't highlight mid word for ints
-    prev_sep = is_separator(c);
-    i++;
-
-    // we're setting hl_open_comment flag to whether the row was part of multi-line comment
-    int changed = (row->hl_open_comment != in_comment);
-    row->hl_open_comment = in_comment;
-    if (changed && row->idx + 1 < E.numrows) {
-      // Keep checking if we have to update syntax until we.. don't 
-      editorUpdateSyntax(&E.row[row->idx + 1]);
+  struct editorColdCache *c = &E.cold.cache[E.cold.next];
+  E.cold.next = (E.cold.next + 1) % KILO_COLD_CACHE;
+  c->blk = NULL;
+  if (c->cap < blk->raw)
+  {
+    editorFree(MEM_COLD, c->raw);
+    c->raw = editorMalloc(MEM_COLD, blk->raw);
+    if (c->raw == NULL)
+    {
+      die("malloc");
     }
+    c->cap = blk->raw;
   }
+  if (editorLzDecompress(blk->data, blk->zlen, c->raw, blk->raw) == -1)
+  {
+    die("cold block");
+  }
+  c->blk = blk;
+  return c->raw;
 }
 
-int editorSyntaxToColor(int hl)
+// a row's text, warm or not - good until the next call
+const char *editorRowText(erow *row)
 {
-  // Case statement to return proper colour used in esc char sequence
-  switch (hl)
-  {
-  case HL_MLCOMMENT:
-  case HL_COMMENT:
-    return 36;
-  case HL_KEYWORD1:
-    return 33;
-  case HL_KEYWORD2:
-    return 32;
-  case HL_STRING:
-    return 35;
-  case HL_NUMBER:
-    return 31;
-  case HL_MATCH:
-    return 34;
-  default:
-    return 37;
-  }
+  return row->cold ? editorColdRaw(row->cold) + row->cold_off : row->chars;
 }
 
-void editorSelectSyntaxHighlight()
+// one row of the block has left it, the block goes once they all have
+void editorColdDrop(coldBlock *blk)
 {
-  E.syntax = NULL;
-  if (E.filename == NULL)
+  E.cold.rows--;
+  if (--blk->rows > 0)
   {
     return;
   }
-
-  for (unsigned int j = 0; j < HLDB_ENTRIES; j++)
+  for (int i = 0; i < KILO_COLD_CACHE; i++)
   {
-    struct editorSyntax *s = &HLDB[j];
-    unsigned int i = 0;
-    while (s->filematch[i])
+    if (E.cold.cache[i].blk == blk)
     {
-      char *p = strstr(E.filename, s->filematch[i]);
-      if (p != NULL)
-      {
-        int patlen = strlen(s->filematch[i]);
-        if (s->filematch[i][0] != '.' || p[patlen] == '\0')
-        {
-          E.syntax = s;
-
-          int filerow;
-          for (filerow = 0; filerow < E.numrows; filerow++)
-          {
-            editorUpdateSyntax(&E.row[filerow]);
-          }
-
-          return;
-        }
-      }
-      i++;
+      E.cold.cache[i].blk = NULL;
     }
   }
+  E.cold.blocks--;
+  E.cold.raw -= blk->raw;
+  editorFree(MEM_COLD, blk);
 }
 
-/** file I/O ***/
-
-int editorRowCxToRx(erow *row, int cx)
+// give a frozen row its text back and render it again
+void editorRowWarm(erow *row)
 {
-  int rx = 0;
-  int j;
-  for (j = 0; j < cx; j++)
+  if (row->cold == NULL)
   {
-    // if the current char we're looping over is tab
-    if (row->chars[j] == '\t')
-    {
-      // Add tab 'spaces' to move cursor in row
-      rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
-    }
-    rx++;
+    return;
   }
-  return rx;
+  coldBlock *blk = row->cold;
+  char *chars = editorTextAlloc(row->size + 1);
+  memcpy(chars, editorColdRaw(blk) + row->cold_off, row->size);
+  chars[row->size] = '\0';
+  row->chars = chars;
+  row->cold = NULL;
+  editorColdDrop(blk);
+  editorUpdateRow(row);
 }
 
-int editorRowRxToCx(erow *row, int rx)
+// within KILO_COLD_WINDOW rows of the screen or the cursor, likely to be looked at soon
+int editorRowNearView(size_t y)
 {
-  int cur_rx = 0;
-  int cx;
-  for (cx = 0; cx < row->size; cx++)
-  {
-    if (row->chars[cx] == '\t')
-    {
-      // Skipping over the \t char
-      cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
-    }
-    cur_rx++;
+  size_t top = E.rowoff > KILO_COLD_WINDOW ? E.rowoff - KILO_COLD_WINDOW : 0;
+  size_t cy = E.cy > KILO_COLD_WINDOW ? E.cy - KILO_COLD_WINDOW : 0;
+  return (y >= top && y < E.rowoff + E.screenrows + KILO_COLD_WINDOW) ||
+         (y >= cy && y < E.cy + KILO_COLD_WINDOW);
+}
 
-    if (cur_rx > rx)
-    {
-      return cx;
-    }
+// drop a row's render, checkpoints and hl, its width and comment state stay
+void editorRowDropDisplay(erow *row)
+{
+  rowDisplay *d = ROW_DISPLAY(row);
+  editorRowUnshare(row);
+  editorFree(MEM_HL, d->hl); // a borrowed one went back in editorRowUnshare
+  d->hl = NULL;
+  d->rsize = 0;
+  d->ncp = 0;
+}
+
+// warm, its text not shared, and not near anything that's about to be looked at
+int editorColdEligible(size_t y)
+{
+  erow *row = &E.row[y];
+  if (row->cold || ROW_TEXT(row->chars)->refs > 1)
+  {
+    return 0;
   }
-  return cx;
+  return !editorRowNearView(y);
 }
 
-void editorUpdateRow(erow *row)
+/**
+ * Compress the text of the n rows listed in 'rows', 'raw' bytes of it,
+ * into one block and drop everything else they hold. They needn't be
+ * next to each other. Returns 0 and leaves them alone if it wouldn't
+ * save at least an eighth.
+ */
+int editorColdFreeze(const size_t *rows, size_t n, size_t raw)
 {
-  int tabs = 0;
-  int j;
-  for (j = 0; j < row->size; j++)
+  if (raw < 64)
   {
-    // Check if tabs char is present in row to be rendered
-    if (row->chars[j] == '\t')
-    {
-      tabs++;
-    }
+    return 0;
+  }
+  char *buf = malloc(raw);
+  size_t cap = raw - raw / 8;
+  coldBlock *blk = editorMalloc(MEM_COLD, sizeof(coldBlock) + cap);
+  if (buf == NULL || blk == NULL)
+  {
+    free(buf);
+    editorFree(MEM_COLD, blk);
+    return 0;
+  }
+  size_t off = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    memcpy(&buf[off], E.row[rows[i]].chars, E.row[rows[i]].size);
+    off += E.row[rows[i]].size;
+  }
+  size_t zlen = editorLzCompress(buf, raw, blk->data, cap);
+  free(buf);
+  if (zlen == 0)
+  {
+    editorFree(MEM_COLD, blk);
+    return 0;
+  }
+  coldBlock *fit = editorRealloc(MEM_COLD, blk, sizeof(coldBlock) + zlen);
+  if (fit)
+  {
+    blk = fit;
   }
+  blk->rows = n;
+  blk->raw = raw;
+  blk->zlen = zlen;
 
-  // free the memory currently in use
-  free(row->render);
-  // Allocate new memory as row size +1 + tabs*7
-  row->render = malloc(row->size + tabs * (KILO_TAB_STOP - 1) + 1);
+  off = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    erow *row = &E.row[rows[i]];
+    editorRowDropDisplay(row);
+    editorTextRelease(row->chars);
+    row->chars = NULL;
+    row->cold = blk;
+    row->cold_off = off;
+    off += row->size;
+  }
+  E.cold.blocks++;
+  E.cold.rows += n;
+  E.cold.raw += raw;
+  return 1;
+}
 
-  int idx = 0;
-  // Loop through all chars in row
-  for (j = 0; j < row->size; j++)
+/**
+ * Freeze rows until we're back under the budget, starting where the
+ * last call stopped, compressing at most 'work' bytes. Called when idle
+ * and after each batch the loader inserts, so loading a file bigger
+ * than the budget never holds all of it uncompressed. A pass over the
+ * whole file that finds nothing left to freeze isn't repeated until
+ * memory use has grown again.
+ */
+void editorColdPoll(size_t work)
+{
+  size_t used = editorColdUsed();
+  if (E.cold.budget == 0 || E.view.active || used <= E.cold.budget || used <= E.cold.full)
   {
-    // if current char is tab
-    if (row->chars[j] == '\t')
+    return;
+  }
+  E.cold.full = 0;
+  size_t pick[KILO_COLD_ROWS];
+  size_t scanned = 0, done = 0;
+  while (done < work && scanned < KILO_COLD_SCAN && editorColdUsed() > E.cold.budget)
+  {
+    if (E.cold.swept >= E.numrows)
     {
-      // add in spaces for count of 8 (or.. sometimes it's less dependent on how far away end of tab is)
-      row->render[idx++] = ' ';
-      while (idx % KILO_TAB_STOP != 0)
+      E.cold.full = editorColdUsed();
+      E.cold.swept = 0;
+      return;
+    }
+    // the next rows that can go, stepping over the ones that can't
+    size_t n = 0, bytes = 0;
+    while (n < KILO_COLD_ROWS && bytes < KILO_COLD_BLOCK && E.cold.swept < E.numrows && scanned < KILO_COLD_SCAN)
+    {
+      if (E.cold.hand >= E.numrows)
+      {
+        E.cold.hand = 0;
+      }
+      size_t y = E.cold.hand++;
+      E.cold.swept++;
+      scanned++;
+      if (editorColdEligible(y))
       {
-        row->render[idx++] = ' ';
+        pick[n++] = y;
+        bytes += E.row[y].size;
       }
     }
-    else
+    if (n > 0 && editorColdFreeze(pick, n, bytes))
     {
-      // copy them to render array
-      row->render[idx++] = row->chars[j];
+      E.cold.swept = 0;
+      done += bytes;
     }
   }
-  row->render[idx] = '\0'; // append end of line char
-  row->rsize = idx;        // size of row
-
-  // checking for highlighting
-  editorUpdateSyntax(row);
 }
 
-void editorInsertRow(int at, char *s, size_t len)
+// 512K, 64M, 2G
+size_t editorParseSize(const char *s)
 {
-  if (at < 0 || at > E.numrows)
+  char *end;
+  size_t n = strtoull(s, &end, 10);
+  switch (toupper((unsigned char)*end))
   {
-    return;
-  }
-
-  // Adding new memory to end of row
-  E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-
-  // moving chars to end of row
-  memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-
-  for (int j = at + 1; j <= E.numrows; j++) {
-    E.row[j].idx++;
+  case 'G':
+    n *= 1024;
+    // fall through
+  case 'M':
+    n *= 1024;
+    // fall through
+  case 'K':
+    n *= 1024;
   }
-
-  // See current row index
-  E.row[at].idx = at;
-
-  // copy given string to end of eRow
-  E.row[at].size = len;
-  E.row[at].chars = malloc(len + 1);
-  // Copy the line to chars in row
-  memcpy(E.row[at].chars, s, len);
-  // each erow represents 1 line of text, so no need for the new line
-  E.row[at].chars[len] = '\0';
-
-  E.row[at].rsize = 0;
-  E.row[at].render = NULL;
-  E.row[at].hl = NULL;
-
-  E.row[at].hl_open_comment = 0;
-
-  editorUpdateRow(&E.row[at]); // pass reference to current row
-
-  E.numrows++;
-  E.dirty++; // trying to gather how much file was changes
+  return n;
 }
 
-// Free memory
-void editorFreeRow(erow *row)
-{
-  free(row->render);
-  free(row->chars);
-  free(row->hl);
-}
+/*** render eviction ***/
+
+/**
+ * --render-budget (or KILO_RENDER_BUDGET) caps the render, checkpoints
+ * and hl kept for rows. Every row is rendered as it's loaded (its width
+ * and the comment state it leaves are needed from the start), but only
+ * rows being drawn or moved around in need the rest. Past the budget a
+ * CLOCK sweep drops it from rows that haven't been used since the hand
+ * last came by: the first pass clears a row's used bit, the next one
+ * drops it if it's still clear. A dropped row keeps rwidth and
+ * hl_open_comment in its erow, so wrapping and the rows after it don't
+ * notice, and editorRowDisplay renders it again the next time it's
+ * needed.
+ */
 
-void editorDelRow(int at)
+// a row's render / hl, rebuilt first if it was dropped (or thawed if frozen)
+rowDisplay *editorRowDisplay(erow *row)
 {
-  // Sanity checking
-  if (at < 0 || at >= E.numrows)
+  rowDisplay *d = ROW_DISPLAY(row);
+  if (row->cold)
   {
-    return;
+    editorRowWarm(row);
   }
-
-  // Remove memory of current row
-  editorFreeRow(&E.row[at]);
-  
-  for (int j = at; k < E.numrows - 1; j++) {
-    E.row[j].idx--;
+  else if (d->render == NULL && !E.batch)
+  {
+    E.evict.rebuilt++;
+    editorUpdateRow(row);
   }
-
-  // Moving the next row to the current row being deleted's position
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-  E.numrows--;
-  E.dirty++;
+  d->used = 1;
+  return d;
 }
 
 /**
- * Function inserts a single char into an erow
+ * Drop render / hl until we're back under the budget, looking at no
+ * more than 'work' rows. Called when idle and after each batch the
+ * loader inserts. Rows near the screen or the cursor are kept.
  */
-void editorRowInsertChar(erow *row, int at, int c)
+void editorEvictPoll(size_t work)
 {
-  if (at < 0 || at > row->size)
+  size_t used = E.mem[MEM_RENDER].bytes + E.mem[MEM_HL].bytes;
+  if (E.evict.budget == 0 || E.batch || used <= E.evict.budget || used <= E.evict.full)
   {
-    at = row->size;
+    return;
   }
+  E.evict.full = 0;
+  for (size_t scanned = 0; scanned < work && E.mem[MEM_RENDER].bytes + E.mem[MEM_HL].bytes > E.evict.budget; scanned++)
+  {
+    if (E.evict.swept >= 2 * E.numrows)
+    {
+      // every used bit has been cleared and nothing more could go
+      E.evict.full = E.mem[MEM_RENDER].bytes + E.mem[MEM_HL].bytes;
+      E.evict.swept = 0;
+      return;
+    }
+    if (E.evict.hand >= E.numrows)
+    {
+      E.evict.hand = 0;
+    }
+    size_t y = E.evict.hand++;
+    E.evict.swept++;
+    rowDisplay *d = &E.display[y];
+    if (d->render == NULL)
+    {
+      continue;
+    }
+    if (d->used)
+    {
+      d->used = 0; // second chance
+      continue;
+    }
+    if (editorRowNearView(y))
+    {
+      continue;
+    }
+    editorRowDropDisplay(&E.row[y]);
+    E.evict.evicted++;
+    E.evict.swept = 0;
+  }
+}
 
-  row->chars = realloc(row->chars, row->size + 2);
-
-  // memmove > like memcpy, but good for if source and dest overlap
-  memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+/*** latency stats ***/
 
-  row->size++;
-  row->chars[at] = c;
-  editorUpdateRow(row);
-  E.dirty++; // attempting to get a sense of how many changes made to file
+uint64_t editorNowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-void editorRowAppendString(erow *row, char *s, size_t len)
+size_t editorHistIndex(uint64_t v)
 {
-
-  // Adding the addition memory to end of row
-  row->chars = realloc(row->chars, row->size + len + 1);
-
-  // Copying the characters to the free memory at end of row
-  memcpy(&row->chars[row->size], s, len);
-
-  row->size += len; // updating row's size
-
-  row->chars[row->size] = '\0'; // added EoL char
-
-  editorUpdateRow(row);
-  E.dirty++;
+  if (v < (2 << STATS_SUB_BITS))
+  {
+    return v;
+  }
+  int msb = 63 - __builtin_clzll(v);
+  int shift = msb - STATS_SUB_BITS;
+  return ((size_t)(shift + 1) << STATS_SUB_BITS) + ((v >> shift) - (1 << STATS_SUB_BITS));
 }
 
-void editorRowDelChar(erow *row, int at)
+// largest value that lands in bucket idx
+uint64_t editorHistValue(size_t idx)
 {
-  // sanity check char to delete is in row length bounds
-  if (at < 0 || at >= row->size)
+  if (idx < (2 << STATS_SUB_BITS))
   {
-    return;
+    return idx;
   }
-
-  // Moving all chars 1 to left, and reducing size of row by 1
-  memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-
-  row->size--;
-
-  // update the row to remove the deleted char
-  editorUpdateRow(row);
-
-  // show the fiel is 'dirtier'
-  E.dirty++;
+  int shift = (idx >> STATS_SUB_BITS) - 1;
+  uint64_t low = ((uint64_t)(1 << STATS_SUB_BITS) + (idx & ((1 << STATS_SUB_BITS) - 1))) << shift;
+  return low + ((uint64_t)1 << shift) - 1;
 }
 
-/*** Editor operations ***/
-
-// insert acharacter at position of pointer
-void editorInsertChar(int c)
+// record the time since start
+void editorStatsRecord(int stat, uint64_t start)
 {
-
-  if (E.cy == E.numrows)
+  uint64_t ns = editorNowNs() - start;
+  struct editorHistogram *h = &E.stats.hist[stat];
+  h->buckets[editorHistIndex(ns)]++;
+  h->count++;
+  h->sum += ns;
+  if (ns > h->max)
   {
-    // Make a new row at the end if cursor position is max row
-    editorInsertRow(E.numrows, "", 0);
+    h->max = ns;
   }
+}
 
-  editorRowInsertChar(&E.row[E.cy], E.cx, c);
-  E.cx++;
+uint64_t editorHistPercentile(struct editorHistogram *h, double p)
+{
+  uint64_t want = (uint64_t)(p / 100 * h->count + 0.5);
+  uint64_t seen = 0;
+  want = want ? want : 1;
+  for (size_t i = 0; i < STATS_BUCKETS; i++)
+  {
+    seen += h->buckets[i];
+    if (seen >= want)
+    {
+      // the bucket's top end, but never past the largest value seen
+      return editorHistValue(i) < h->max ? editorHistValue(i) : h->max;
+    }
+  }
+  return h->max;
 }
 
-void editorInsertNewline()
+// short human readable duration: 850ns, 12us, 2.1ms, 1.3s
+void editorStatsFormat(char *buf, size_t size, uint64_t ns)
 {
-  // handling the 'enter' keypress
-  if (E.cx == 0)
+  if (ns < 1000)
   {
-    // If we're at beginning of file / line, just add new row
-    editorInsertRow(E.cy, "", 0);
+    snprintf(buf, size, "%uns", (unsigned)ns);
+  }
+  else if (ns < 1000000)
+  {
+    snprintf(buf, size, "%uus", (unsigned)(ns / 1000));
+  }
+  else if (ns < 1000000000)
+  {
+    snprintf(buf, size, "%.1fms", ns / 1e6);
   }
   else
   {
-    // Create reference to current row
-    erow *row = &E.row[E.cy];
-    // Insert the new line mid row
-    editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-    // change current row to row at cursor y pos
-    row = &E.row[E.cy];
-    row->size = E.cx;             // Current row size is position of cursor x position
-    row->chars[row->size] = '\0'; // append end of line char
-    editorUpdateRow(row);         // update the current row
+    snprintf(buf, size, "%.1fs", ns / 1e9);
   }
-  E.cy++;   // make cursor change to next line
-  E.cx = 0; // set cursor to beginnig of the row
 }
 
-void editorDelChar()
+// "key 40us/2.1ms draw ..." - p50/p99 of each histogram for the status bar
+int editorStatsOverlay(char *buf, size_t size)
 {
-  // Sanity checking we're not deleting last row
-  if (E.cy == E.numrows)
+  static const char *names[STAT_COUNT] = {"key", "draw", "hl", "find"};
+  int len = 0;
+  for (int i = 0; i < STAT_COUNT && (size_t)len < size; i++)
+  {
+    struct editorHistogram *h = &E.stats.hist[i];
+    char p50[16] = "-", p99[16] = "-";
+    if (h->count)
+    {
+      editorStatsFormat(p50, sizeof(p50), editorHistPercentile(h, 50));
+      editorStatsFormat(p99, sizeof(p99), editorHistPercentile(h, 99));
+    }
+    len += snprintf(buf + len, size - len, "%s%s %s/%s", i ? " " : "", names[i], p50, p99);
+  }
+  return (size_t)len < size ? len : (int)size - 1;
+}
+
+// write every histogram out in full, for comparing hosts
+void editorStatsDump()
+{
+  static const char *names[STAT_COUNT] = {"key-to-paint", "refresh", "highlight", "search"};
+
+  char *path = editorPrompt("Dump stats to: %s (ESC to cancel)", NULL);
+  if (path == NULL)
   {
+    editorSetStatusMessage("Stats dump aborted");
     return;
   }
 
-  if (E.cx == 0 && E.cy == 0)
+  FILE *fp = fopen(path, "w");
+  if (!fp)
   {
+    editorSetStatusMessage("Can't write stats to %s: %s", path, strerror(errno));
+    free(path);
     return;
   }
 
-  // get reference to row to be deleted;
-  erow *row = &E.row[E.cy];
-
-  // Checking cursor position on row is valid
-  if (E.cx > 0)
-  {
-    // Delete char at cursor
-    editorRowDelChar(row, E.cx - 1);
-    // decrement cursor position
-    E.cx--;
-  }
-  else
+  fprintf(fp, "# kilo %s latency stats, nanoseconds\n", KILO_VERSION);
+  for (int i = 0; i < STAT_COUNT; i++)
   {
-    // handling case where cursor is at the begginning of a line and we need to
-    // move all the current row onto the end of the row before it
-    E.cx = E.row[E.cy - 1].size;
-    editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
-    editorDelRow(E.cy);
-    E.cy--;
+    struct editorHistogram *h = &E.stats.hist[i];
+    fprintf(fp, "\n%s: count %llu mean %llu max %llu\n", names[i],
+            (unsigned long long)h->count,
+            (unsigned long long)(h->count ? h->sum / h->count : 0),
+            (unsigned long long)h->max);
+    if (!h->count)
+    {
+      continue;
+    }
+    fprintf(fp, "  p50 %llu p90 %llu p99 %llu p99.9 %llu\n",
+            (unsigned long long)editorHistPercentile(h, 50),
+            (unsigned long long)editorHistPercentile(h, 90),
+            (unsigned long long)editorHistPercentile(h, 99),
+            (unsigned long long)editorHistPercentile(h, 99.9));
+
+    // the non-empty buckets, as "<= upper bound: count"
+    for (size_t b = 0; b < STATS_BUCKETS; b++)
+    {
+      if (h->buckets[b])
+      {
+        fprintf(fp, "  <= %llu: %u\n", (unsigned long long)editorHistValue(b), h->buckets[b]);
+      }
+    }
   }
+  editorMemDump(fp);
+  fclose(fp);
+
+  editorSetStatusMessage("Stats written to %s", path);
+  free(path);
 }
 
-/*** file i/o ***/
+/*** tracing ***/
 
-/**
- * Convert arrow structs into a single string
- * that can be written to file
- */
-char *editorRowsToString(int *buflen)
+void editorTraceEvent(const char *name, char ph, size_t arg)
 {
-  int totlen = 0;
-  int j;
-  // add up lengths of each row
-  for (j = 0; j < E.numrows; j++)
+  traceEvent *ev = &E.trace.ring[E.trace.count++ % E.trace.cap];
+  ev->name = name;
+  ev->ph = ph;
+  ev->arg = arg;
+  ev->ns = editorNowNs();
+}
+
+// cheap enough to leave in hot paths, one branch when tracing is off
+void editorTraceBegin(const char *name, size_t arg)
+{
+  if (E.trace.ring)
   {
-    totlen += E.row[j].size + 1; //+1 for bewline char
+    editorTraceEvent(name, 'B', arg);
   }
+}
 
-  *buflen = totlen;
-
-  char *buf = malloc(totlen);
-  char *p = buf;
-
-  // cpy each row into buffer
-  for (j = 0; j < E.numrows; j++)
+void editorTraceEnd(const char *name)
+{
+  if (E.trace.ring)
   {
-    memcpy(p, E.row[j].chars, E.row[j].size);
-    p += E.row[j].size;
-    *p = '\n'; // append new line to end of row
-    p++;
+    editorTraceEvent(name, 'E', SIZE_MAX);
   }
-
-  return buf;
 }
 
-void editorOpen(char *filename)
+// atexit - dump the ring as Chrome trace JSON for Perfetto / chrome://tracing
+void editorTraceWrite()
 {
-  free(E.filename);
-  E.filename = strdup(filename); // strdup comes from string.h
-  // makes copy of given string, allocating required memory and assuming you will free the memory
-
-  // Check the file type
-  editorSelectSyntaxHighlight();
-
-  FILE *fp = fopen(filename, "r");
-
+  FILE *fp = fopen(E.trace.path, "w");
   if (!fp)
   {
-    die("fopen");
+    return;
   }
 
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
-  // read lines from file
-  while ((linelen = getline(&line, &linecap, fp)) != -1)
+  size_t first = E.trace.count > E.trace.cap ? E.trace.count - E.trace.cap : 0;
+  size_t depth = 0;
+  int comma = 0;
+  fprintf(fp, "{\"traceEvents\":[\n");
+  for (size_t i = first; i < E.trace.count; i++)
   {
-    // if linelen == -1, it's at the end of the file
-    while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
+    traceEvent *ev = &E.trace.ring[i % E.trace.cap];
+
+    // ends whose begin was overwritten would unbalance the stack
+    if (ev->ph == 'E' && depth == 0)
     {
-      linelen--;
+      continue;
     }
-    editorInsertRow(E.numrows, line, linelen);
+    depth += ev->ph == 'B' ? 1 : -1;
+
+    fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":1",
+            comma ? ",\n" : "", ev->name, ev->ph, (ev->ns - E.trace.start_ns) / 1e3, (int)getpid());
+    if (ev->arg != SIZE_MAX)
+    {
+      fprintf(fp, ",\"args\":{\"row\":%zu}", ev->arg);
+    }
+    fprintf(fp, "}");
+    comma = 1;
   }
-  free(line);
+  fprintf(fp, "\n]}\n");
   fclose(fp);
-  E.dirty = 0; // resetting on new load
 }
 
-void editorSave()
+void editorTraceStart(char *path)
 {
-  /**
-   * In the future,you can change this to write to a temp file,
-   * then check for errors when you change tmp file to actual name provided
-   */
+  E.trace.cap = KILO_TRACE_EVENTS;
+  E.trace.ring = malloc(sizeof(traceEvent) * E.trace.cap);
+  E.trace.count = 0;
+  E.trace.path = path;
+  E.trace.start_ns = editorNowNs();
+  atexit(editorTraceWrite);
+}
 
-  // if new file
-  if (E.filename == NULL)
+/*** terminal ***/
+void die(const char *s)
+{
+  // get any unsaved edits into the swap file before we go
+  editorJournalFlush(1);
+
+  // clear screen on exit
+  if (!E.batch)
   {
-    E.filename = editorPrompt("Save as: %s (ESC to cancel)", NULL);
-    if (E.filename == NULL)
-    {
-      editorSetStatusMessage("Save aborted");
-      return;
-    }
-    editorSelectSyntaxHighlight();
+    write(STDOUT_FILENO, "\x1b[2J", 4);
+    write(STDOUT_FILENO, "\x1b[H", 3);
   }
 
-  int len;
-  char *buf = editorRowsToString(&len); // get the char buffer
-
-  // open (or create if it doesn't exist) for reading
-  int fd = open(E.filename, O_RDWR | O_CREAT, 0644); // 0644 is the permissions
+  perror(s); // prints string given to it before error occured
+  exit(1);
+}
 
-  // error checking
-  if (fd != -1)
+void disableRawMode()
+{
+  // If we can't disable raw mode, exit
+  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
   {
-    if (ftruncate(fd, len) != -1)
-    { // sets file size to specific length
-      // write string to path E.filename
-      if (write(fd, buf, len) == len)
-      {
-        close(fd);
-        free(buf);
-        E.dirty = 0; // resetting on save
-        editorSetStatusMessage("%d bytes written to disk", len);
-        return;
-      }
-    }
-    close(fd);
+    die("tcsetattr");
   }
-
-  free(buf);
-  editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
 
-/*** FIND ***/
-void editorFindCallback(char *query, int key)
+/**
+ * Function to modify struct variables / flags
+ * all of these variables / objects come from termios.h
+ */
+void enableRawMode()
 {
+  if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1)
+  {
+    // if we can' get the raw mode attributes, exit
+    die("tcgetattr");
+  } // Save struct to orig_termios var
 
-  // declaring static vars as only 1 will appear in program
-  static int last_match = -1;
-  static int direction = 1; // forward/back search
+  atexit(disableRawMode); // at exit, disable the raw mode
 
-  // static variables to keep state
-  static int saved_hl_line;     // reference to line changed
-  static char *saved_hl = NULL; // memory of line changed, NULL when nothing to restore
+  struct termios raw = E.orig_termios;
 
-  if (saved_hl)
+  // Disabling ctrl-s & ctrl-q - input types
+  raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+
+  // disabling output processing
+  raw.c_oflag &= ~(OPOST);
+
+  // Bit mask with multiple bits ( | = bitwise OR )
+  raw.c_cflag |= (CS8);
+
+  // Read input byte-by-byte, not line-by-line
+  // Turn off canonical mode
+  // turn off Ctrl-c and ctrl-z signals
+  raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+  // ~ (BITWISE NOT) > from 0010 to 1101
+  // & (BITWISE AND) > from 0010 to 0000
+  /*
+    BITWISE AND
+    0  0  >  0
+    0  1  >  0
+    1  0  >  0
+    1  1  >  1
+    */
+
+  // c.cc = control characters - array of bytes with terminal settings
+  raw.c_cc[VMIN] = 0;  // num bytes before read can return
+  raw.c_cc[VTIME] = 1; // max time to wait before read returns (100mS)
+
+  if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1)
   {
-    // Restoring the line that was changed
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-    free(saved_hl);
-    saved_hl = NULL;
-  }
+    // if we can't set the new attributes, exit
+    die("tcsetattr");
+  } // setting attrbiute
+  // TCASFLUSH - specifies when to apply change, here we wait until output to be written to terminal
+}
 
-  // return if the key pressed was ESC or RET
-  if (key == '\r' || key == '\x1b')
+// default frame sink, straight to the terminal
+void editorTermWrite(void *ctx, const char *buf, size_t len)
+{
+  (void)ctx;
+  write(STDOUT_FILENO, buf, len);
+}
+
+void editorOutputWrite(const char *buf, size_t len)
+{
+  E.out.write(E.out.ctx, buf, len);
+}
+
+// one byte of input, from the terminal or a replayed trace
+int editorReadByte(char *c)
+{
+#ifdef KILO_BENCH
+  if (bench_replay)
   {
-    last_match = -1;
-    direction = 1;
-    return;
+    return editorBenchReadByte(c);
   }
-  else if (key == ARROW_RIGHT || key == ARROW_DOWN)
+#endif
+  int nread = read(STDIN_FILENO, c, 1);
+
+  // --record: keep the raw bytes so the session can be replayed by the benchmark
+  if (nread == 1 && E.record_fd != -1)
   {
-    direction = 1;
+    write(E.record_fd, c, 1);
   }
-  else if (key == ARROW_LEFT || key == ARROW_UP)
+  return nread;
+}
+
+// wait for a key press and return it
+int editorReadKey()
+{
+  int nread;
+  char c;
+#ifdef KILO_BENCH
+  if (bench_replay)
   {
-    direction = -1;
+    editorBenchMark(); // previous key has been fully handled and drawn
   }
-  else
+#endif
+  while ((nread = editorReadByte(&c)) != 1)
   {
-    // resetting search vars
-    last_match = -1;
-    direction = 1;
+    if (nread == -1 && errno != EAGAIN && errno != EINTR)
+    {
+      die("read");
+    }
+    // read timed out, nothing typed for 100ms
+    editorIdle();
   }
+  E.stats.key_ns = editorNowNs(); // key-to-paint clock starts here
 
-  if (last_match == -1)
+  if (c == '\x1b')
   {
-    direction = 1;
-  }
-  int current = last_match; // current is index of row we're currently searching
-
-  int i;
 
-  // loop through all rows in file, if row contain str it's a match
-  for (i = 0; i < E.numrows; i++)
-  {
+    char seq[3];
 
-    current += direction;
-    if (current == -1)
+    if (editorReadByte(&seq[0]) != 1)
     {
-      // if there's no current, then current = last line
-      current = E.numrows - 1;
+      return '\x1b';
     }
-    else if (current == E.numrows)
+    if (editorReadByte(&seq[1]) != 1)
     {
-      // if the search is in last row (status row) then current = 0
-      current = 0;
+      return '\x1b';
     }
 
-    erow *row = &E.row[current];
-    // compare strings
-    char *match = strstr(row->render, query);
-    if (match)
+    // replacing up|down|left|right arrows with WASD
+    if (seq[0] == '[')
     {
-      last_match = current;
-      E.cy = current;
-      E.cx = editorRowRxToCx(row, match - row->render);
-      E.rowoff = E.numrows;
-      // set to bottom of file
-      // so the next screen refresh will make search str found
-      // be placed at the top of the screen
-
-      saved_hl_line = current; // Line that was changed
-      saved_hl = malloc(row->rsize);
-      // copying line to allocated memory before highlighting was applied
-      // so we can restore it to default next time we enter this funtion
-      memcpy(saved_hl, row->hl, row->rsize);
-      // setting the highlighted region for the found strings in search code
-      memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
-      break;
-    }
-  }
-}
-
-void editorFind()
-{
-
-  int saved_cx = E.cx;
-  int saved_cy = E.cy;
-  int saved_coloff = E.coloff;
-  int saved_rowoff = E.rowoff;
-
-  char *query = editorPrompt("Search: %s (ESC/Arrows/Enter)", editorFindCallback);
-
-  if (query)
-  {
-    free(query);
-  }
-  else
-  {
-    // resetting the cursor if cancelled search
-    E.cx = saved_cx;
-    E.cy = saved_cy;
-    E.coloff = saved_coloff;
-    E.rowoff = saved_rowoff;
-  }
-}
-
-/*** append buffer ***/
-// Instead of doing x small writes, we are making buffer to do 1 big write
+      if (seq[1] >= '0' && seq[1] <= '9')
+      {
 
-// creating our own dynamic string type
-struct abuf
-{
-  char *b;
-  int len;
-};
+        if (editorReadByte(&seq[2]) != 1)
+        {
+          return '\x1b';
+        }
 
-// acts as constructor for the abuf type
-#define ABUF_INIT \
-  {               \
-    NULL, 0       \
+        // if byte after [ is a digit
+        // read another byte expecting ~
+        // See if digit byte was 5 or 6
+        if (seq[2] == '~')
+        {
+          switch (seq[1])
+          {
+          case '1':
+            return HOME_KEY;
+          case '3':
+            return DEL_KEY;
+          case '4':
+            return END_KEY;
+          case '5':
+            return PAGE_UP;
+          case '6':
+            return PAGE_DOWN;
+          case '7':
+            return HOME_KEY;
+          case '8':
+            return END_KEY;
+          }
+        }
+      }
+      else
+      {
+        switch (seq[1])
+        {
+        case 'A':
+          return ARROW_UP;
+        case 'B':
+          return ARROW_DOWN;
+        case 'C':
+          return ARROW_RIGHT;
+        case 'D':
+          return ARROW_LEFT;
+        case 'H':
+          return HOME_KEY;
+        case 'F':
+          return END_KEY;
+        }
+      }
+    }
+    else if (seq[0] == 'O')
+    {
+      switch (seq[1])
+      {
+      case 'H':
+        return HOME_KEY;
+      case 'F':
+        return END_KEY;
+      }
+    }
+    return '\x1b';
+  }
+  else
+  {
+    // unsigned so UTF-8 bytes don't turn into negative keys
+    return (unsigned char)c;
   }
+}
 
-void abAppend(struct abuf *ab, const char *s, int len)
+int getCursorPosition(int *rows, int *cols)
 {
-  // realloc comes from <stdlib.h>
-  // makes sure we have enough memory to hold new string
-  char *new = realloc(ab->b, ab->len + len);
-  // gives us memory = cur_mem_size + new_thing_to_append
 
-  // return if the size is null
-  if (new == NULL)
+  char buf[32];
+  unsigned int i = 0;
+
+  // 'n' is device status report command - finding cursor pos
+  // https://vt100.net/docs/vt100-ug/chapter3.html#DSR
+  if (write(STDOUT_FILENO, "\x1b[6n", 4) != 4)
   {
-    return;
+    return -1;
   }
 
-  // memcpy comes from <string.h>
-  // copy string s after the end of current data
-  memcpy(&new[ab->len], s, len);
-  ab->b = new;
-  ab->len += len;
+  // read in to fill the buffer - breka on 'R' character
+  while (i < sizeof(buf) - 1)
+  {
+    if (read(STDIN_FILENO, &buf[i], 1) != 1)
+    {
+      break;
+    }
+    if (buf[i] == 'R')
+    {
+      break;
+    }
+    i++;
+  }
+
+  // make the final byte \0
+  buf[i] = '\0';
+
+  // make sur eit responded with escape character
+  if (buf[0] != '\x1b' || buf[1] != '[')
+  {
+    return -1;
+  }
+  // pass pointer to 3rd ele of buf[]
+  if (sscanf(&buf[2], "%d;%d", rows, cols) != 2)
+  {
+    return -1;
+  }
+
+  return 0;
 }
 
-// deconstructor that deallocates dynamic memory used by an abuf
-void abFree(struct abuf *ab)
+// // // get the size of the terminal
+int getWindowSize(int *rows, int *cols)
 {
-  // comes from <stdlib.h>
-  free(ab->b);
+
+  // ioctl(), TIOCGWINSZ, and struct winsize come from <sys/ioctl.h>.
+  struct winsize ws;
+
+  // on success, system call will place numbers of cols and rows in winsize struct
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0)
+  {
+
+    // C -> move the cursor right 999 spaces
+    // B -> move the cursor down 999 spaces
+    if (write(STDOUT_FILENO, "\x1b[999C\x1b[999B", 12) != 12)
+    {
+      return -1;
+    }
+    // return current current position
+    return getCursorPosition(rows, cols);
+  }
+  else
+  {
+    // setting the references passed to new values
+    // common way to return multiple values in C
+    *cols = ws.ws_col;
+    *rows = ws.ws_row;
+    return 0;
+  }
 }
 
-/*** output ***/
-void editorScroll()
+/*** Syntax highlighting ***/
+
+int is_separator(int c)
 {
-  E.rx = 0; // change cursor to be render item not chars
-  if (E.cy < E.numrows)
+  // ctype functions only take unsigned char values, UTF-8 bytes are negative chars
+  c = (unsigned char)c;
+  // Checking if the current character is a separator character
+  return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+void editorHighlightRow(erow *row)
+{
+  rowDisplay *d = ROW_DISPLAY(row);
+  if (row->cold || d->render == NULL)
   {
-    E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    editorRowDisplay(row); // highlights it once it has its text / render back
+    return;
   }
+  int starts_in_comment = (ROW_IDX(row) > 0 && E.row[ROW_IDX(row) - 1].hl_open_comment);
 
-  // check if cursor moved outside of visible window
-  // adjust E.rowoff so cursor is just inside visible window
-  if (E.cy < E.rowoff)
+  // an identical row starting the same way was highlighted already
+  rowShape *sh = d->shape;
+  if (sh && d->rsize && sh->hl[starts_in_comment] && sh->syntax == E.syntax)
   {
-    E.rowoff = E.cy;
+    if (!editorRowHlShared(row))
+    {
+      editorFree(MEM_HL, d->hl);
+    }
+    d->hl = sh->hl[starts_in_comment];
+    int changed = (row->hl_open_comment != sh->hl_open[starts_in_comment]);
+    row->hl_open_comment = sh->hl_open[starts_in_comment];
+    if (changed && ROW_IDX(row) + 1 < E.numrows)
+    {
+      editorHighlightRow(&E.row[ROW_IDX(row) + 1]);
+    }
+    return;
   }
-  if (E.cy >= E.rowoff + E.screenrows)
+  if (editorRowHlShared(row))
   {
-    E.rowoff = E.cy - E.screenrows + 1;
+    d->hl = NULL; // not ours to write to
   }
 
-  if (E.rx < E.coloff)
-  {
-    E.coloff = E.rx;
-  }
-  if (E.rx >= E.coloff + E.screencols)
+  // Create a new array of memory for the highlighting, same size of row
+  d->hl = editorRealloc(MEM_HL, d->hl, d->rsize);
+  // Set all the items in hl array to 'HL_NORMAL'
+  memset(d->hl, HL_NORMAL, d->rsize);
+
+  // There's not filetype for the current file, don't highlight syntax
+  if (E.syntax == NULL)
   {
-    E.coloff = E.rx - E.screencols + 1;
+    editorRowShareHl(row, starts_in_comment);
+    return;
   }
-}
 
-void editorDrawRows(struct abuf *ab)
-{
-  int y;
-  for (y = 0; y < E.screenrows; y++)
+  // one event per row, so a cascade down the file shows up as a nested stack
+  editorTraceBegin("highlight", ROW_IDX(row));
+
+  char **keywords = E.syntax->keywords;
+
+  char *scs = E.syntax->singleline_comment_start;
+  char *mcs = E.syntax->multiline_comment_start;
+  char *mce = E.syntax->multiline_comment_end;
+
+  size_t scs_len = scs ? strlen(scs) : 0;
+  size_t mcs_len = mcs ? strlen(mcs) : 0;
+  size_t mce_len = mce ? strlen(mce) : 0;
+
+  // making sure the ints in the middle of a word are not hihglighted.
+  int prev_sep = 1;
+  int in_string = 0;
+  int in_comment = starts_in_comment; // Better way to check we're in a multi-line comment
+
+  size_t i = 0;
+  // Go through all itmes in row
+
+  // whikle loop allows for multiple characters each function call
+  while (i < d->rsize)
   {
-    int filerow = y + E.rowoff; // displaying correct line of the file if reading from file
+    char c = d->render[i];
+    unsigned char prev_hl = (i > 0) ? d->hl[i - 1] : HL_NORMAL;
 
-    // check if the row we're drawing is part of text buffer or row that comes before / after
-    if (filerow >= E.numrows)
+    if (scs_len && !in_string && !in_comment)
     {
-
-      // don't write the welcome message if we have read in a file
-      if (E.numrows == 0 && y == E.screenrows / 3)
+      // check if char is the start of single line comment
+      if (!strncmp(&d->render[i], scs, scs_len))
       {
-        char welcome[80];
-        // snprinft - comes from <stdio.h>
-        // interpolate KILO_VERSION string into welcome msg
-        int welcomelen = snprintf(welcome, sizeof(welcome),
-                                  "Kilo editor -- version %s", KILO_VERSION);
+        memset(&d->hl[i], HL_COMMENT, d->rsize - i);
+        break;
+      }
+    }
 
-        // truncate string length if terminal is too small
-        if (welcomelen > E.screencols)
+    if (mcs_len && mce_len && !in_string)
+    {
+      if (in_comment)
+      {
+        d->hl[i] = HL_MLCOMMENT;
+        if (!strncmp(&d->render[i], mce, mce_len))
         {
-          welcomelen = E.screencols;
+          // if we're at the end of the multiline comment, finish highlighting and continue
+          memset(&d->hl[i], HL_MLCOMMENT, mce_len);
+          i += mce_len;
+          in_comment = 0;
+          prev_sep = 1;
+          continue;
         }
+        else if (!strncmp(&d->render[i], mcs, mcs_len))
+        {
+          // If we've just entered the Multiline comment, swap the variables to show this
+          memset(&d->hl[i], HL_MLCOMMENT, mcs_len);
+          i += mcs_len;
+          in_comment = 1;
+          continue;
+        }
+      }
+    }
 
-        // creating padding around the welcome string in the terminal
-        int padding = (E.screencols - welcomelen) / 2;
-
-        if (padding)
+    if (E.syntax->flags & HL_HIGHLIGHT_STRINGS)
+    {
+      if (in_string)
+      {
+        d->hl[i] = HL_STRING;
+        // If we're in a string, and there's a \, we know there's another few characters on next row that nned highlight
+        if (c == '\\' && i + 1 < d->rsize)
         {
-          abAppend(ab, "~", 1);
-          padding--;
+          d->hl[i + 1] = HL_STRING;
+          i += 2;
+          continue;
         }
-        while (padding--)
+        if (c == in_string)
         {
-          abAppend(ab, " ", 1);
+          in_string = 0;
         }
-        abAppend(ab, welcome, welcomelen);
+        i++;
+        prev_sep = 1;
+        continue;
       }
       else
       {
-        // making sure we write ~ on every row
-        // write(STDOUT_FILENO, "~", 1);
-        abAppend(ab, "~", 1);
-      }
-    }
-    else
-    {
-
-      // displaying correct row at each y position of text editor
-      // adjusting for coloff(set) to keep x position correct too
-      int len = E.row[filerow].rsize - E.coloff;
+        // highlighting double and single quote string
+        if (c == '"' || c == '\'')
+        {
+          in_string = c;
+          d->hl[i] = HL_STRING;
+          i++;
+          continue;
+        }
+      }
+    }
+
+    if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS)
+    {
+      // If the item is a digit & allowing for decimal points
+      if ((isdigit((unsigned char)c) && (prev_sep || prev_hl == HL_NUMBER)) ||
+          (c == '.' && prev_hl == HL_NUMBER))
+      {
+        // set the highlight array in same position to number highlight
+        d->hl[i] = HL_NUMBER;
+        i++;
+        prev_sep = 0;
+        continue;
+      }
+    }
 
-      if (len < 0)
+    if (prev_sep)
+    {
+      int j;
+      for (j = 0; keywords[j]; j++)
+      {
+        size_t klen = strlen(keywords[j]);
+        int kw2 = keywords[j][klen - 1] == '|';
+        if (kw2)
+        {
+          klen--;
+        }
+        if (!strncmp(&d->render[i], keywords[j], klen) &&
+            is_separator(d->render[i + klen]))
+        {
+          memset(&d->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+          i += klen;
+          break;
+        }
+      }
+      if (keywords[j] != NULL)
       {
-        len = 0;
+        prev_sep = 0;
+        continue;
       }
-      if (len > E.screencols)
+    }
+
+    // checking if previous step was separator so we don't highlight mid word for ints
+    prev_sep = is_separator(c);
+    i++;
+
+    // we're setting hl_open_comment flag to whether the row was part of multi-line comment
+    int changed = (row->hl_open_comment != in_comment);
+    row->hl_open_comment = in_comment;
+    if (changed && ROW_IDX(row) + 1 < E.numrows) {
+      // Keep checking if we have to update syntax until we.. don't 
+      editorHighlightRow(&E.row[ROW_IDX(row) + 1]);
+    }
+  }
+  editorRowShareHl(row, starts_in_comment);
+  editorTraceEnd("highlight");
+}
+
+// highlight a row and whatever it cascades into, timed as one
+void editorUpdateSyntax(erow *row)
+{
+  uint64_t start = editorNowNs();
+  editorHighlightRow(row);
+  editorStatsRecord(STAT_SYNTAX, start);
+}
+
+int editorSyntaxToColor(int hl)
+{
+  // Case statement to return proper colour used in esc char sequence
+  switch (hl)
+  {
+  case HL_MLCOMMENT:
+  case HL_COMMENT:
+    return 36;
+  case HL_KEYWORD1:
+    return 33;
+  case HL_KEYWORD2:
+    return 32;
+  case HL_STRING:
+    return 35;
+  case HL_NUMBER:
+    return 31;
+  case HL_MATCH:
+    return 34;
+  default:
+    return 37;
+  }
+}
+
+void editorSelectSyntaxHighlight()
+{
+  E.syntax = NULL;
+  if (E.filename == NULL)
+  {
+    return;
+  }
+
+  for (unsigned int j = 0; j < HLDB_ENTRIES; j++)
+  {
+    struct editorSyntax *s = &HLDB[j];
+    unsigned int i = 0;
+    while (s->filematch[i])
+    {
+      char *p = strstr(E.filename, s->filematch[i]);
+      if (p != NULL)
       {
-        len = E.screencols;
+        int patlen = strlen(s->filematch[i]);
+        if (s->filematch[i][0] != '.' || p[patlen] == '\0')
+        {
+          E.syntax = s;
+
+          size_t filerow;
+          for (filerow = 0; filerow < E.numrows; filerow++)
+          {
+            editorUpdateSyntax(&E.row[filerow]);
+          }
+
+          return;
+        }
       }
+      i++;
+    }
+  }
+}
+
+/** file I/O ***/
+
+/**
+ * index of the last checkpoint starting at or before 'pos', or -1.
+ * 'field' is the offsetof the coordinate to search (cx, rx or rb),
+ * checkpoints are sorted in all three.
+ */
+ssize_t editorRowFindCheckpoint(erow *row, size_t field, size_t pos)
+{
+  rowDisplay *d = ROW_DISPLAY(row);
+  ssize_t lo = 0, hi = (ssize_t)d->ncp - 1, found = -1;
+  while (lo <= hi)
+  {
+    ssize_t mid = lo + (hi - lo) / 2;
+    size_t start = *(size_t *)((char *)&d->cp[mid] + field);
+    if (start <= pos)
+    {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid - 1;
+    }
+  }
+  return found;
+}
+
+// binary search the checkpoints instead of walking the row from column 0
+size_t editorRowCxToRx(erow *row, size_t cx)
+{
+  rowDisplay *d = editorRowDisplay(row);
+  ssize_t k = editorRowFindCheckpoint(row, offsetof(rowCheckpoint, cx), cx);
+  if (k == -1)
+  {
+    return cx; // no tabs before cx, columns match chars
+  }
+  if (cx < d->cp[k].cxe)
+  {
+    return d->cp[k].rx;
+  }
+  return d->cp[k].rxe + (cx - d->cp[k].cxe);
+}
+
+size_t editorRowRxToCx(erow *row, size_t rx)
+{
+  rowDisplay *d = editorRowDisplay(row);
+  size_t cx;
+  ssize_t k = editorRowFindCheckpoint(row, offsetof(rowCheckpoint, rx), rx);
+  if (k == -1)
+  {
+    cx = rx;
+  }
+  else if (rx < d->cp[k].rxe)
+  {
+    return d->cp[k].cx; // column is inside the tab
+  }
+  else
+  {
+    cx = d->cp[k].cxe + (rx - d->cp[k].rxe);
+  }
+  return (cx > row->size) ? row->size : cx;
+}
+
+// screen column of a byte offset into render (e.g. a search match)
+size_t editorRowRbToRx(erow *row, size_t rb)
+{
+  rowDisplay *d = editorRowDisplay(row);
+  ssize_t k = editorRowFindCheckpoint(row, offsetof(rowCheckpoint, rb), rb);
+  if (k == -1)
+  {
+    return rb;
+  }
+  if (rb < d->cp[k].rbe)
+  {
+    // tabs are expanded to one space per column, UTF-8 chars aren't
+    size_t into = rb - d->cp[k].rb;
+    return (d->cp[k].rbe - d->cp[k].rb == d->cp[k].rxe - d->cp[k].rx) ? d->cp[k].rx + into : d->cp[k].rx;
+  }
+  return d->cp[k].rxe + (rb - d->cp[k].rbe);
+}
+
+// byte offset into render of the char at cx (e.g. a selection edge)
+size_t editorRowCxToRb(erow *row, size_t cx)
+{
+  rowDisplay *d = editorRowDisplay(row);
+  ssize_t k = editorRowFindCheckpoint(row, offsetof(rowCheckpoint, cx), cx);
+  if (k == -1)
+  {
+    return cx;
+  }
+  if (cx < d->cp[k].cxe)
+  {
+    return d->cp[k].rb;
+  }
+  return d->cp[k].rbe + (cx - d->cp[k].cxe);
+}
+
+// chars index of the start of the char before cx, stepping over UTF-8 continuation bytes
+size_t editorRowPrevChar(erow *row, size_t cx)
+{
+  editorRowWarm(row);
+  if (cx == 0)
+  {
+    return 0;
+  }
+  cx--;
+  while (cx > 0 && ((unsigned char)row->chars[cx] & 0xC0) == 0x80)
+  {
+    cx--;
+  }
+  return cx;
+}
+
+// chars index of the start of the char after cx
+size_t editorRowNextChar(erow *row, size_t cx)
+{
+  editorRowWarm(row);
+  if (cx >= row->size)
+  {
+    return row->size;
+  }
+  cx++;
+  while (cx < row->size && ((unsigned char)row->chars[cx] & 0xC0) == 0x80)
+  {
+    cx++;
+  }
+  return cx;
+}
+
+/*** UTF-8 ***/
+
+// checks 16 bytes at a time when SSE2 is around, 8 at a time otherwise
+int editorIsAscii(const char *s, size_t len)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    if (_mm_movemask_epi8(v) != 0)
+    {
+      return 0; // some byte has its top bit set
+    }
+  }
+#else
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t w;
+    memcpy(&w, s + i, 8);
+    if (w & 0x8080808080808080ULL)
+    {
+      return 0;
+    }
+  }
+#endif
+  for (; i < len; i++)
+  {
+    if ((unsigned char)s[i] & 0x80)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Decode one UTF-8 char, returns how many bytes it used
+ * or 0 if the bytes aren't valid UTF-8
+ */
+int editorUtf8Decode(const char *str, size_t len, uint32_t *out)
+{
+  const unsigned char *s = (const unsigned char *)str;
+  int n;
+  uint32_t cp;
+  uint32_t min;
+
+  if (s[0] < 0x80)
+  {
+    *out = s[0];
+    return 1;
+  }
+  else if (s[0] >= 0xC2 && s[0] <= 0xDF)
+  {
+    n = 2;
+    cp = s[0] & 0x1F;
+    min = 0x80;
+  }
+  else if (s[0] >= 0xE0 && s[0] <= 0xEF)
+  {
+    n = 3;
+    cp = s[0] & 0x0F;
+    min = 0x800;
+  }
+  else if (s[0] >= 0xF0 && s[0] <= 0xF4)
+  {
+    n = 4;
+    cp = s[0] & 0x07;
+    min = 0x10000;
+  }
+  else
+  {
+    return 0;
+  }
+
+  if ((size_t)n > len)
+  {
+    return 0;
+  }
+  for (int i = 1; i < n; i++)
+  {
+    if ((s[i] & 0xC0) != 0x80)
+    {
+      return 0;
+    }
+    cp = (cp << 6) | (s[i] & 0x3F);
+  }
+  // overlong encodings, surrogates and past the end of unicode
+  if (cp < min || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+  {
+    return 0;
+  }
+  *out = cp;
+  return n;
+}
+
+// columns a code point takes on a terminal: combining marks 0, CJK / emoji 2
+int editorCharWidth(uint32_t cp)
+{
+  static const uint32_t zero[][2] = {
+      {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x0610, 0x061A},
+      {0x064B, 0x065F}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F},
+      {0x20D0, 0x20FF}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}};
+  static const uint32_t wide[][2] = {
+      {0x1100, 0x115F}, {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF},
+      {0x4E00, 0x9FFF}, {0xA000, 0xA4CF}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF},
+      {0xFE30, 0xFE4F}, {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x1F300, 0x1F64F},
+      {0x1F900, 0x1F9FF}, {0x20000, 0x3FFFD}};
+
+  for (size_t i = 0; i < sizeof(zero) / sizeof(zero[0]); i++)
+  {
+    if (cp >= zero[i][0] && cp <= zero[i][1])
+    {
+      return 0;
+    }
+  }
+  for (size_t i = 0; i < sizeof(wide) / sizeof(wide[0]); i++)
+  {
+    if (cp >= wide[i][0] && cp <= wide[i][1])
+    {
+      return 2;
+    }
+  }
+  return 1;
+}
+
+void editorUpdateRow(erow *row)
+{
+  rowDisplay *d = ROW_DISPLAY(row);
+  if (E.batch)
+  {
+    return; // nothing is ever drawn, render / hl / checkpoints aren't needed
+  }
+  editorTraceBegin("update-row", ROW_IDX(row));
+  editorRowUnshare(row);
+
+  // another row with this text was rendered already, use what it built
+  rowShape *sh = editorTextShape(row->chars);
+  if (sh && sh->render)
+  {
+    sh->refs++;
+    d->shape = sh;
+    d->render = sh->render;
+    d->rsize = sh->rsize;
+    row->rwidth = sh->rwidth;
+    d->cp = sh->cp;
+    d->ncp = sh->ncp;
+    d->ascii = sh->ascii;
+    editorWrapRowChanged(row);
+    editorUpdateSyntax(row);
+    editorTraceEnd("update-row");
+    return;
+  }
+
+  // pure ASCII rows (the common case) skip all the UTF-8 work
+  d->ascii = editorIsAscii(row->chars, row->size);
+
+  size_t tabs = 0;
+  size_t wide = 0; // upper bound on multibyte chars - their lead bytes
+  size_t j;
+  for (j = 0; j < row->size; j++)
+  {
+    // Check if tabs char is present in row to be rendered
+    if (row->chars[j] == '\t')
+    {
+      tabs++;
+    }
+    else if (!d->ascii && ((unsigned char)row->chars[j] & 0xC0) == 0xC0)
+    {
+      wide++;
+    }
+  }
+
+  // Allocate new memory as row size +1 + tabs*7 (the old one went in editorRowUnshare)
+  d->render = editorMalloc(MEM_RENDER, row->size + tabs * (KILO_TAB_STOP - 1) + 1);
+
+  // one checkpoint per tab / UTF-8 char, old ones are stale now the row changed
+  d->cp = (tabs + wide) ? editorMalloc(MEM_RENDER, sizeof(rowCheckpoint) * (tabs + wide)) : NULL;
+
+  size_t idx = 0; // render byte
+  size_t col = 0; // screen column
+  size_t k = 0;
+  // Loop through all chars in row
+  for (j = 0; j < row->size; j++)
+  {
+    // if current char is tab
+    if (row->chars[j] == '\t')
+    {
+      d->cp[k].cx = j;
+      d->cp[k].cxe = j + 1;
+      d->cp[k].rx = col;
+      d->cp[k].rb = idx;
+      // add in spaces for count of 8 (or.. sometimes it's less dependent on how far away end of tab is)
+      d->render[idx++] = ' ';
+      col++;
+      while (col % KILO_TAB_STOP != 0)
+      {
+        d->render[idx++] = ' ';
+        col++;
+      }
+      d->cp[k].rxe = col;
+      d->cp[k++].rbe = idx;
+    }
+    else if (!d->ascii && ((unsigned char)row->chars[j] & 0x80))
+    {
+      uint32_t cp;
+      int n = editorUtf8Decode(&row->chars[j], row->size - j, &cp);
+      if (n == 0)
+      {
+        // not valid UTF-8, show a single placeholder column
+        d->render[idx++] = '?';
+        col++;
+        continue;
+      }
+      // cache the width, drawing and cursor moves never decode the row again
+      int w = editorCharWidth(cp);
+      d->cp[k].cx = j;
+      d->cp[k].cxe = j + n;
+      d->cp[k].rx = col;
+      d->cp[k].rxe = col + w;
+      d->cp[k].rb = idx;
+      d->cp[k++].rbe = idx + n;
+      memcpy(&d->render[idx], &row->chars[j], n);
+      idx += n;
+      col += w;
+      j += n - 1;
+    }
+    else
+    {
+      // copy them to render array
+      d->render[idx++] = row->chars[j];
+      col++;
+    }
+  }
+  d->ncp = k;
+  d->render[idx] = '\0'; // append end of line char
+  d->rsize = idx;        // size of row
+  row->rwidth = col;
+
+  // first of several rows with this text, the rest will use this render
+  rowText *t = ROW_TEXT(row->chars);
+  if (t->hash && t->refs > 1)
+  {
+    if (sh == NULL)
+    {
+      sh = editorMalloc(MEM_RENDER, sizeof(rowShape));
+      if (sh == NULL)
+      {
+        die("malloc");
+      }
+      memset(sh, 0, sizeof(*sh));
+      sh->refs = 1; // the table entry's reference
+      editorInternFind(t)->shape = sh;
+    }
+    sh->refs++;
+    d->shape = sh;
+    sh->render = d->render;
+    sh->rsize = d->rsize;
+    sh->rwidth = row->rwidth;
+    sh->cp = d->cp;
+    sh->ncp = d->ncp;
+    sh->ascii = d->ascii;
+  }
+
+  // row may now wrap onto a different number of screen lines
+  editorWrapRowChanged(row);
+
+  // checking for highlighting
+  editorUpdateSyntax(row);
+  editorTraceEnd("update-row");
+}
+
+/**
+ * Insert n rows at 'at', growing and shifting the row array once.
+ * Each row takes over the text reference in chars[i] - the clipboard
+ * pastes whole rows this way without copying them.
+ */
+void editorInsertRowsText(size_t at, char **chars, const size_t *lens, size_t n)
+{
+  if (at > E.numrows)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      editorTextRelease(chars[i]);
+    }
+    return;
+  }
+
+  // rows that already exist somewhere share that text
+  for (size_t i = 0; i < n; i++)
+  {
+    chars[i] = editorTextIntern(chars[i], lens[i]);
+  }
+
+  // Adding new memory to end of row
+  E.row = editorRealloc(MEM_ROWS, E.row, sizeof(erow) * (E.numrows + n));
+  E.display = editorRealloc(MEM_ROWS, E.display, sizeof(rowDisplay) * (E.numrows + n));
+
+  // moving chars to end of row, the rows after them are renumbered by moving
+  memmove(&E.row[at + n], &E.row[at], sizeof(erow) * (E.numrows - at));
+  memmove(&E.display[at + n], &E.display[at], sizeof(rowDisplay) * (E.numrows - at));
+  E.numrows += n;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    erow *row = &E.row[at + i];
+    row->size = lens[i];
+    row->chars = chars[i];
+    row->rwidth = 0;
+    row->hl_open_comment = 0;
+    row->cont = 0;
+    row->cold = NULL;
+  }
+  memset(&E.display[at], 0, sizeof(rowDisplay) * n); // nothing rendered yet
+
+  editorWrapSplice(at, 0, n); // every row after these moved down
+  for (size_t i = 0; i < n; i++)
+  {
+    editorUpdateRow(&E.row[at + i]); // pass reference to current row
+    editorRecordOp(OP_INSERT_ROW, at + i, 0, chars[i], lens[i]);
+  }
+  E.dirty++; // trying to gather how much file was changes
+}
+
+void editorInsertRow(size_t at, char *s, size_t len)
+{
+  // copy given string into the row's own text
+  char *chars = editorTextAlloc(len + 1);
+  memcpy(chars, s, len);
+  // each erow represents 1 line of text, so no need for the new line
+  chars[len] = '\0';
+  editorInsertRowsText(at, &chars, &len, 1);
+}
+
+// Free memory
+void editorFreeRow(erow *row)
+{
+  rowDisplay *d = ROW_DISPLAY(row);
+  if (row->cold)
+  {
+    editorColdDrop(row->cold);
+    row->cold = NULL;
+  }
+  editorRowUnshare(row);
+  editorTextRelease(row->chars);
+  editorFree(MEM_HL, d->hl);
+}
+
+// remove n rows starting at 'at', shifting the row array once
+void editorDelRows(size_t at, size_t n)
+{
+  // Sanity checking
+  if (at >= E.numrows)
+  {
+    return;
+  }
+  if (n > E.numrows - at)
+  {
+    n = E.numrows - at;
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    // keep the text so the delete can be undone, each one replays at 'at'
+    editorRecordOp(OP_DELETE_ROW, at, 0, editorRowText(&E.row[at + i]), E.row[at + i].size);
+
+    // Remove memory of current row
+    editorFreeRow(&E.row[at + i]);
+  }
+
+  // Moving the next rows to the deleted rows' position, which renumbers them
+  memmove(&E.row[at], &E.row[at + n], sizeof(erow) * (E.numrows - at - n));
+  memmove(&E.display[at], &E.display[at + n], sizeof(rowDisplay) * (E.numrows - at - n));
+  E.numrows -= n;
+  editorWrapSplice(at, n, 0);
+  E.dirty++;
+}
+
+void editorDelRow(size_t at)
+{
+  editorDelRows(at, 1);
+}
+
+/**
+ * Function inserts a string into an erow at position 'at'
+ */
+void editorRowInsertString(erow *row, size_t at, const char *s, size_t len)
+{
+  editorRowWarm(row);
+  if (at > row->size)
+  {
+    at = row->size;
+  }
+
+  // Adding the addition memory to end of row (or a copy if it's shared)
+  row->chars = editorTextOwn(row->chars, row->size, row->size + len + 1);
+
+  // memmove > like memcpy, but good for if source and dest overlap
+  memmove(&row->chars[at + len], &row->chars[at], row->size - at + 1);
+
+  // Copying the characters into the gap we just made
+  memcpy(&row->chars[at], s, len);
+
+  row->size += len; // updating row's size
+
+  editorUpdateRow(row);
+  E.dirty++; // attempting to get a sense of how many changes made to file
+  editorRecordOp(OP_INSERT, ROW_IDX(row), at, s, len);
+}
+
+/**
+ * Function inserts a single char into an erow
+ */
+void editorRowInsertChar(erow *row, size_t at, int c)
+{
+  char ch = c;
+  editorRowInsertString(row, at, &ch, 1);
+}
+
+void editorRowAppendString(erow *row, char *s, size_t len)
+{
+  editorRowInsertString(row, row->size, s, len);
+}
+
+/**
+ * Function removes 'len' chars from an erow starting at 'at'
+ */
+void editorRowDelString(erow *row, size_t at, size_t len)
+{
+  // sanity check chars to delete are in row length bounds
+  if (at >= row->size || len == 0)
+  {
+    return;
+  }
+  if (len > row->size - at)
+  {
+    len = row->size - at;
+  }
+  editorRowWarm(row);
+
+  editorRecordOp(OP_DELETE, ROW_IDX(row), at, &row->chars[at], len);
+
+  // Moving all chars after the deleted ones to the left, and reducing size of row
+  row->chars = editorTextOwn(row->chars, row->size, row->size + 1);
+  memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+
+  row->size -= len;
+
+  // update the row to remove the deleted chars
+  editorUpdateRow(row);
+
+  // show the fiel is 'dirtier'
+  E.dirty++;
+}
+
+/**
+ * Swap n non-overlapping matches of oldlen bytes at the offsets in 'at'
+ * (ascending) for 'with', building the new text in a single allocation.
+ * The caller records the change.
+ */
+void editorRowReplaceAt(erow *row, const size_t *at, size_t n, size_t oldlen, const char *with, size_t wlen)
+{
+  editorRowWarm(row);
+  size_t size = row->size - n * oldlen + n * wlen;
+  char *chars = editorTextAlloc(size + 1);
+  size_t from = 0, to = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    memcpy(&chars[to], &row->chars[from], at[i] - from);
+    to += at[i] - from;
+    memcpy(&chars[to], with, wlen);
+    to += wlen;
+    from = at[i] + oldlen;
+  }
+  memcpy(&chars[to], &row->chars[from], row->size - from);
+  chars[size] = '\0';
+
+  editorTextRelease(row->chars);
+  row->chars = chars;
+  row->size = size;
+  editorUpdateRow(row);
+  E.dirty++;
+}
+
+void editorRowDelChar(erow *row, size_t at)
+{
+  editorRowDelString(row, at, 1);
+}
+
+// mark whether a row runs on into the next one (a chunk of a long line)
+void editorRowSetCont(erow *row, int cont)
+{
+  if (row->cont == cont)
+  {
+    return;
+  }
+  char old = row->cont;
+  row->cont = cont;
+  E.dirty++;
+  editorRecordOp(OP_SET_CONT, ROW_IDX(row), cont, &old, 1);
+}
+
+/**
+ * Long lines are stored as a chain of KILO_CHUNK_SIZE rows, so an edit
+ * only reallocs, re-renders and re-highlights the chunk it touches.
+ * Where to cut a chunk off 's' without splitting a UTF-8 char.
+ */
+size_t editorChunkLen(const char *s, size_t len)
+{
+  if (len <= KILO_CHUNK_SIZE)
+  {
+    return len;
+  }
+  size_t n = KILO_CHUNK_SIZE;
+  while (n > 1 && ((unsigned char)s[n] & 0xC0) == 0x80)
+  {
+    n--;
+  }
+  return n;
+}
+
+// split a row that edits have grown well past the chunk size
+void editorRowFitChunks(size_t at)
+{
+  while (at < E.numrows && E.row[at].size > 2 * KILO_CHUNK_SIZE)
+  {
+    erow *row = &E.row[at];
+    editorRowWarm(row);
+    size_t n = editorChunkLen(row->chars, row->size);
+    int cont = row->cont;
+
+    editorInsertRow(at + 1, &E.row[at].chars[n], E.row[at].size - n);
+    editorRowSetCont(&E.row[at + 1], cont);
+    editorRowDelString(&E.row[at], n, E.row[at].size - n);
+    editorRowSetCont(&E.row[at], 1);
+
+    // cursor follows its text into the new chunk
+    if (E.cy == at && E.cx > n)
+    {
+      E.cy++;
+      E.cx -= n;
+    }
+    at++;
+  }
+}
+
+/*** undo ***/
+
+#define UNDO_REC_SIZE(len) (sizeof(editorOp) + (len) + sizeof(size_t))
+
+/**
+ * OP_REPLACE keeps its match list small - LEB128 varints of
+ *   qlen wlen, the query, the replacement, then for each row touched:
+ *   row delta, match count, and each match's gap from the previous one
+ * so a million one-per-line matches take a few bytes each.
+ */
+size_t editorPutVarint(char *buf, size_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80)
+  {
+    buf[n++] = (char)(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = (char)v;
+  return n;
+}
+
+size_t editorGetVarint(const char *buf, size_t *v)
+{
+  size_t n = 0;
+  int shift = 0;
+  *v = 0;
+  do
+  {
+    *v |= (size_t)(buf[n] & 0x7F) << shift;
+    shift += 7;
+  } while (buf[n++] & 0x80);
+  return n;
+}
+
+// an OP_REPLACE record being put together
+struct replaceRec
+{
+  char *buf;
+  size_t len;
+  size_t cap;
+  size_t prev;     // last row added
+  size_t first;    // first row touched, SIZE_MAX while none
+  size_t firstcol; // first match in it
+  size_t qlen;
+};
+
+void editorReplaceRecStart(struct replaceRec *rec, const char *query, size_t qlen, const char *with, size_t wlen)
+{
+  rec->cap = 64 + qlen + wlen;
+  rec->buf = editorMalloc(MEM_UNDO, rec->cap);
+  if (rec->buf == NULL)
+  {
+    die("malloc");
+  }
+  rec->len = editorPutVarint(rec->buf, qlen);
+  rec->len += editorPutVarint(&rec->buf[rec->len], wlen);
+  memcpy(&rec->buf[rec->len], query, qlen);
+  memcpy(&rec->buf[rec->len + qlen], with, wlen);
+  rec->len += qlen + wlen;
+  rec->prev = 0;
+  rec->first = SIZE_MAX;
+  rec->firstcol = 0;
+  rec->qlen = qlen;
+}
+
+// n matches in row y at the ascending offsets in 'at'
+void editorReplaceRecRow(struct replaceRec *rec, size_t y, const size_t *at, size_t n)
+{
+  // worst case 10 bytes a varint
+  if (rec->len + 20 + n * 10 > rec->cap)
+  {
+    char *buf = editorRealloc(MEM_UNDO, rec->buf, (rec->len + 20 + n * 10) * 2);
+    if (buf == NULL)
+    {
+      die("realloc");
+    }
+    rec->buf = buf;
+    rec->cap = (rec->len + 20 + n * 10) * 2;
+  }
+  rec->len += editorPutVarint(&rec->buf[rec->len], y - rec->prev);
+  rec->len += editorPutVarint(&rec->buf[rec->len], n);
+  size_t end = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    rec->len += editorPutVarint(&rec->buf[rec->len], at[i] - end);
+    end = at[i] + rec->qlen;
+  }
+
+  if (rec->first == SIZE_MAX)
+  {
+    rec->first = y;
+    rec->firstcol = at[0];
+  }
+  rec->prev = y;
+}
+
+// record it if anything was replaced, and let it go
+void editorReplaceRecDone(struct replaceRec *rec)
+{
+  if (rec->first != SIZE_MAX)
+  {
+    editorRecordOp(OP_REPLACE, rec->first, rec->firstcol, rec->buf, rec->len);
+  }
+  editorFree(MEM_UNDO, rec->buf);
+}
+
+/**
+ * Redo (or undo, with inverse) a recorded replace-all. Undoing is a
+ * replace-all of its own going the other way, and gets recorded as one
+ * so the journal and the dirty tracking see it.
+ */
+void editorApplyReplace(editorOp *op, const char *text, int inverse)
+{
+  const char *p = text;
+  const char *end = text + op->len;
+  size_t qlen, wlen;
+  p += editorGetVarint(p, &qlen);
+  p += editorGetVarint(p, &wlen);
+  const char *query = p;
+  const char *with = p + qlen;
+  p += qlen + wlen;
+
+  struct replaceRec rec;
+  if (inverse)
+  {
+    editorReplaceRecStart(&rec, with, wlen, query, qlen);
+  }
+  else
+  {
+    editorReplaceRecStart(&rec, query, qlen, with, wlen);
+  }
+
+  size_t *at = NULL;
+  size_t cap = 0;
+  size_t y = 0;
+  while (p < end)
+  {
+    size_t dy, n;
+    p += editorGetVarint(p, &dy);
+    p += editorGetVarint(p, &n);
+    y += dy;
+    if (n > cap)
+    {
+      size_t *grown = realloc(at, sizeof(size_t) * n);
+      if (grown == NULL)
+      {
+        die("realloc");
+      }
+      at = grown;
+      cap = n;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      size_t gap;
+      p += editorGetVarint(p, &gap);
+      pos += gap;
+      // offsets are in the original text, undoing needs them in the replaced text
+      at[i] = inverse ? pos + i * wlen - i * qlen : pos;
+      pos += qlen;
+    }
+    if (y < E.numrows && n > 0)
+    {
+      editorReplaceRecRow(&rec, y, at, n);
+      if (inverse)
+      {
+        editorRowReplaceAt(&E.row[y], at, n, wlen, query, qlen);
+      }
+      else
+      {
+        editorRowReplaceAt(&E.row[y], at, n, qlen, with, wlen);
+      }
+    }
+  }
+  free(at);
+  editorReplaceRecDone(&rec);
+}
+
+// records in [from, to) are being thrown away, let go of the clipboards they hold
+void editorUndoRelease(size_t from, size_t to)
+{
+  while (from < to)
+  {
+    editorOp op;
+    memcpy(&op, &E.undo.buf[from], sizeof(editorOp));
+    if (op.type == OP_PASTE || op.type == OP_CUT)
+    {
+      clipOp c;
+      memcpy(&c, &E.undo.buf[from + sizeof(editorOp)], sizeof(c));
+      editorClipRelease(c.clip);
+    }
+    from += UNDO_REC_SIZE(op.len);
+  }
+}
+
+// forget all history
+void editorUndoClear()
+{
+  editorUndoRelease(0, E.undo.len);
+  E.undo.len = E.undo.top = 0;
+}
+
+// reads the header of the record that ends at offset 'end'
+size_t editorUndoRecordBefore(size_t end, editorOp *op)
+{
+  size_t reclen;
+  memcpy(&reclen, &E.undo.buf[end - sizeof(size_t)], sizeof(size_t));
+  memcpy(op, &E.undo.buf[end - reclen], sizeof(editorOp));
+  return end - reclen; // start of the record
+}
+
+// Drop the oldest whole keypresses until 'need' more bytes fit under the limit
+void editorUndoMakeRoom(size_t need)
+{
+  size_t start = 0;
+  while (start < E.undo.len && E.undo.len - start + need > E.undo.limit)
+  {
+    editorOp op;
+    memcpy(&op, &E.undo.buf[start], sizeof(editorOp));
+    unsigned int group = op.group;
+    if (group == E.undo.group)
+    {
+      // the keypress being recorded is all that's left and it still
+      // doesn't fit (a huge cut or paste), so it can't be undone at all
+      E.undo.lost = group;
+      start = E.undo.len;
+      break;
+    }
+    // never split a keypress, half undoing it would corrupt the buffer
+    while (start < E.undo.len)
+    {
+      memcpy(&op, &E.undo.buf[start], sizeof(editorOp));
+      if (op.group != group)
+      {
+        break;
+      }
+      start += UNDO_REC_SIZE(op.len);
+    }
+  }
+  editorUndoRelease(0, start);
+  memmove(E.undo.buf, &E.undo.buf[start], E.undo.len - start);
+  E.undo.len -= start;
+  E.undo.top = (E.undo.top > start) ? E.undo.top - start : 0;
+  if (start > 0 && E.undo.over)
+  {
+    // the oversize record has gone, give its memory back
+    E.undo.over = 0;
+    E.undo.buf = editorRealloc(MEM_UNDO, E.undo.buf, E.undo.limit);
+    E.undo.cap = E.undo.limit;
+  }
+}
+
+// nothing has been recorded for the current keypress yet
+int editorUndoGroupStart()
+{
+  if (E.undo.top == 0)
+  {
+    return 1;
+  }
+  editorOp op;
+  editorUndoRecordBefore(E.undo.top, &op);
+  return op.group != E.undo.group;
+}
+
+/**
+ * A replace-all is recorded as one record for the whole keypress. With
+ * enough matches it's bigger than the limit on its own; rather than
+ * losing it, all older history is dropped and the arena grows to hold
+ * just it until the next edit makes room again.
+ */
+int editorUndoAdmit(size_t reclen)
+{
+  char *new = editorRealloc(MEM_UNDO, E.undo.buf, reclen);
+  if (new == NULL)
+  {
+    return -1;
+  }
+  editorUndoRelease(0, E.undo.len);
+  E.undo.buf = new;
+  E.undo.cap = reclen;
+  E.undo.len = E.undo.top = 0;
+  E.undo.over = 1;
+  return 0;
+}
+
+// make sure the arena can hold 'need' more bytes, growing it by doubling
+int editorUndoReserve(size_t need)
+{
+  if (E.undo.len + need > E.undo.limit)
+  {
+    editorUndoMakeRoom(need);
+  }
+  if (E.undo.len + need > E.undo.cap)
+  {
+    size_t cap = E.undo.cap ? E.undo.cap : 4096;
+    while (cap < E.undo.len + need)
+    {
+      cap *= 2;
+    }
+    if (cap > E.undo.limit)
+    {
+      cap = E.undo.limit;
+    }
+    char *new = editorRealloc(MEM_UNDO, E.undo.buf, cap);
+    if (new == NULL)
+    {
+      return -1;
+    }
+    E.undo.buf = new;
+    E.undo.cap = cap;
+  }
+  return 0;
+}
+
+/**
+ * Try to merge a single char edit into the newest record,
+ * so typing (or backspacing over) a word is one undo step
+ */
+int editorUndoCoalesce(int type, size_t row, size_t col, const char *s)
+{
+  // make room first, it may move or drop the record we want to extend
+  if (editorUndoReserve(1) == -1 || E.undo.top == 0 || E.undo.top != E.undo.len)
+  {
+    return 0;
+  }
+
+  editorOp op;
+  size_t start = editorUndoRecordBefore(E.undo.top, &op);
+  if (op.type != type || op.row != row)
+  {
+    return 0;
+  }
+
+  int append; // does the new char go after the stored text or before it
+  if (type == OP_INSERT && op.col + op.len == col)
+  {
+    append = 1;
+  }
+  else if (type == OP_DELETE && col == op.col)
+  {
+    append = 1; // delete key eating chars after the cursor
+  }
+  else if (type == OP_DELETE && col + 1 == op.col)
+  {
+    append = 0; // backspace eating chars before the cursor
+  }
+  else
+  {
+    return 0;
+  }
+
+  char *text = &E.undo.buf[start + sizeof(editorOp)];
+  if (append)
+  {
+    text[op.len] = *s;
+  }
+  else
+  {
+    memmove(&text[1], text, op.len);
+    text[0] = *s;
+    op.col = col;
+  }
+  op.len++;
+  memcpy(&E.undo.buf[start], &op, sizeof(editorOp));
+
+  size_t reclen = UNDO_REC_SIZE(op.len);
+  memcpy(&E.undo.buf[start + reclen - sizeof(size_t)], &reclen, sizeof(size_t));
+  E.undo.len = E.undo.top = start + reclen;
+  return 1;
+}
+
+// called by every buffer primitive, appends a delta to the journals
+void editorRecordOp(int type, size_t row, size_t col, const char *s, size_t len)
+{
+  // remember where the earliest change is, so saving can skip what's before it
+  // (a continuation flag change adds or removes the newline at the end of the row)
+  size_t dcol = (type == OP_SET_CONT && row < E.numrows) ? E.row[row].size : col;
+  if (row < E.dirty_row || (row == E.dirty_row && dcol < E.dirty_col))
+  {
+    E.dirty_row = row;
+    E.dirty_col = dcol;
+  }
+
+  // the swap file can't use the clipboard pointer, recovery has its own clipboard
+  int clip = type == OP_PASTE || type == OP_CUT;
+  editorJournalOp(type, row, col, s, clip ? offsetof(clipOp, clip) : len);
+
+  if (E.undo.paused)
+  {
+    return;
+  }
+
+  // a new edit throws away anything we could have redone
+  editorUndoRelease(E.undo.top, E.undo.len);
+  E.undo.len = E.undo.top;
+
+  if (E.undo.lost == E.undo.group)
+  {
+    return; // earlier parts of this keypress were already dropped
+  }
+
+  if (len == 1 && (type == OP_INSERT || type == OP_DELETE) &&
+      editorUndoCoalesce(type, row, col, s))
+  {
+    return;
+  }
+
+  size_t reclen = UNDO_REC_SIZE(len);
+  if (reclen > E.undo.limit && type == OP_REPLACE && editorUndoGroupStart() && editorUndoAdmit(reclen) == 0)
+  {
+    // kept past the limit, see editorUndoAdmit
+  }
+  else if (reclen > E.undo.limit || editorUndoReserve(reclen) == -1)
+  {
+    // can't keep this edit, so older history can't be replayed either
+    editorUndoClear();
+    E.undo.lost = E.undo.group;
+    return;
+  }
+  if (E.undo.lost == E.undo.group)
+  {
+    return; // making room had to drop this keypress's own records
+  }
+
+  editorOp op = {type, E.undo.group, row, col, len};
+  char *p = &E.undo.buf[E.undo.len];
+  memcpy(p, &op, sizeof(editorOp));
+  memcpy(p + sizeof(editorOp), s, len);
+  memcpy(p + sizeof(editorOp) + len, &reclen, sizeof(size_t));
+  E.undo.len += reclen;
+  E.undo.top = E.undo.len;
+  if (clip)
+  {
+    clipOp c;
+    memcpy(&c, s, sizeof(c));
+    c.clip->refs++; // released by editorUndoRelease
+  }
+}
+
+// apply an op (or its inverse) through the normal buffer primitives
+void editorApplyOp(editorOp *op, const char *text, int inverse)
+{
+  int type = op->type;
+  if (inverse)
+  {
+    switch (type)
+    {
+    case OP_INSERT:
+      type = OP_DELETE;
+      break;
+    case OP_DELETE:
+      type = OP_INSERT;
+      break;
+    case OP_INSERT_ROW:
+      type = OP_DELETE_ROW;
+      break;
+    case OP_DELETE_ROW:
+      type = OP_INSERT_ROW;
+      break;
+    case OP_PASTE:
+      type = OP_CUT;
+      break;
+    case OP_CUT:
+      type = OP_PASTE;
+      break;
+    }
+  }
+
+  if (type == OP_CLIP || type == OP_CLIP_TEXT)
+  {
+    // replaying the swap file, put back the clipboard the pastes after this use
+    clipOp c;
+    memcpy(&c, text, offsetof(clipOp, clip));
+    if (type == OP_CLIP_TEXT)
+    {
+      editorClipFromText(text, op->len);
+    }
+    else if (op->row <= c.y1 && c.y1 < E.numrows)
+    {
+      editorClipSetRange(op->row, op->col, c.y1, c.x1);
+    }
+    return;
+  }
+
+  if (type == OP_SET_CONT)
+  {
+    // the old value is the one byte of text
+    if (op->row < E.numrows)
+    {
+      editorRowSetCont(&E.row[op->row], inverse ? text[0] : (int)op->col);
+    }
+    return;
+  }
+
+  E.cy = op->row;
+  E.cx = op->col;
+  switch (type)
+  {
+  case OP_REPLACE:
+    editorApplyReplace(op, text, inverse);
+    break;
+  case OP_INSERT:
+    if (op->row < E.numrows)
+    {
+      editorRowInsertString(&E.row[op->row], op->col, text, op->len);
+      E.cx = inverse ? op->col : op->col + op->len;
+    }
+    break;
+  case OP_DELETE:
+    if (op->row < E.numrows)
+    {
+      editorRowDelString(&E.row[op->row], op->col, op->len);
+    }
+    break;
+  case OP_INSERT_ROW:
+    editorInsertRow(op->row, (char *)text, op->len);
+    break;
+  case OP_DELETE_ROW:
+    editorDelRow(op->row);
+    break;
+  case OP_PASTE:
+  case OP_CUT:
+  {
+    // from the undo arena the text holds the clipboard, from the swap file the one rebuilt so far
+    clipOp c;
+    memcpy(&c, text, offsetof(clipOp, clip));
+    c.clip = E.clip.data;
+    if (op->len == sizeof(clipOp))
+    {
+      memcpy(&c, text, sizeof(c));
+    }
+    if (op->row < E.numrows && c.clip != NULL && (type == OP_PASTE || c.y1 < E.numrows))
+    {
+      editorClipOp(type, c.clip, op->row, op->col, c.y1, c.x1);
+    }
+    break;
+  }
+  }
+
+  // keep the cursor inside the buffer
+  if (E.cy > E.numrows)
+  {
+    E.cy = E.numrows;
+  }
+  size_t rowlen = (E.cy < E.numrows) ? E.row[E.cy].size : 0;
+  if (E.cx > rowlen)
+  {
+    E.cx = rowlen;
+  }
+}
+
+// after undoing a keypress, put the cursor where the change started
+void editorUndoPlaceCursor(size_t cy, size_t cx)
+{
+  E.cy = (cy > E.numrows) ? E.numrows : cy;
+  size_t rowlen = (E.cy < E.numrows) ? E.row[E.cy].size : 0;
+  E.cx = (cx > rowlen) ? rowlen : cx;
+}
+
+void editorUndo()
+{
+  if (E.undo.top == 0)
+  {
+    editorSetStatusMessage("Nothing to undo");
+    return;
+  }
+
+  E.undo.paused = 1;
+  editorOp op;
+  size_t start = editorUndoRecordBefore(E.undo.top, &op);
+  unsigned int group = op.group;
+  size_t cy = op.row, cx = op.col;
+  // undo every op of the keypress, newest first
+  while (1)
+  {
+    editorApplyOp(&op, &E.undo.buf[start + sizeof(editorOp)], 1);
+    E.undo.top = start;
+    if (op.type != OP_SET_CONT && (op.row < cy || (op.row == cy && op.col < cx)))
+    {
+      cy = op.row;
+      cx = op.col;
+    }
+    if (start == 0)
+    {
+      break;
+    }
+    size_t prev = editorUndoRecordBefore(start, &op);
+    if (op.group != group)
+    {
+      break;
+    }
+    start = prev;
+  }
+  editorUndoPlaceCursor(cy, cx);
+  E.undo.paused = 0;
+}
+
+void editorRedo()
+{
+  if (E.undo.top == E.undo.len)
+  {
+    editorSetStatusMessage("Nothing to redo");
+    return;
+  }
+
+  E.undo.paused = 1;
+  editorOp op;
+  memcpy(&op, &E.undo.buf[E.undo.top], sizeof(editorOp));
+  unsigned int group = op.group;
+  // redo every op of the keypress, oldest first
+  while (E.undo.top < E.undo.len)
+  {
+    memcpy(&op, &E.undo.buf[E.undo.top], sizeof(editorOp));
+    if (op.group != group)
+    {
+      break;
+    }
+    editorApplyOp(&op, &E.undo.buf[E.undo.top + sizeof(editorOp)], 0);
+    E.undo.top += UNDO_REC_SIZE(op.len);
+  }
+  E.undo.paused = 0;
+}
+
+/*** Editor operations ***/
+
+// insert acharacter at position of pointer
+void editorInsertChar(int c)
+{
+
+  if (E.cy == E.numrows)
+  {
+    // Make a new row at the end if cursor position is max row
+    editorInsertRow(E.numrows, "", 0);
+  }
+
+  editorRowInsertChar(&E.row[E.cy], E.cx, c);
+  E.cx++;
+  editorRowFitChunks(E.cy);
+}
+
+void editorInsertNewline()
+{
+  // handling the 'enter' keypress
+  if (E.cx == 0)
+  {
+    // If we're at beginning of file / line, just add new row
+    editorInsertRow(E.cy, "", 0);
+  }
+  else
+  {
+    // Create reference to current row
+    erow *row = &E.row[E.cy];
+    editorRowWarm(row);
+    int cont = row->cont;
+    // Insert the new line mid row
+    editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
+    // the rest of a long line's chunks now follow the new row
+    editorRowSetCont(&E.row[E.cy + 1], cont);
+    // change current row to row at cursor y pos
+    row = &E.row[E.cy];
+    // Current row size is position of cursor x position
+    editorRowDelString(row, E.cx, row->size - E.cx);
+    editorRowSetCont(row, 0); // this row now ends in the new line
+  }
+  E.cy++;   // make cursor change to next line
+  E.cx = 0; // set cursor to beginnig of the row
+}
+
+// drop an emptied chunk, clearing its cont first so an undo puts it back as one
+void editorDelChunk(size_t at)
+{
+  editorRowSetCont(&E.row[at], 0);
+  editorDelRow(at);
+}
+
+void editorDelChar()
+{
+  // Sanity checking we're not deleting last row
+  if (E.cy == E.numrows)
+  {
+    return;
+  }
+
+  // chunks of a long line that deletes have emptied are dropped on the
+  // way, so backspace keeps going back along the line
+  while (E.cx == 0 && E.cy > 0 && E.row[E.cy - 1].cont && E.row[E.cy - 1].size == 0)
+  {
+    editorDelChunk(E.cy - 1);
+    E.cy--;
+  }
+
+  if (E.cx == 0 && E.cy == 0)
+  {
+    return;
+  }
+
+  // get reference to row to be deleted;
+  erow *row = &E.row[E.cy];
+  editorRowWarm(row);
+
+  // Checking cursor position on row is valid
+  if (E.cx > 0)
+  {
+    // Delete the whole (maybe multibyte) char before the cursor
+    size_t start = editorRowPrevChar(row, E.cx);
+    editorRowDelString(row, start, E.cx - start);
+    // move cursor back over it
+    E.cx = start;
+  }
+  else if (E.row[E.cy - 1].cont)
+  {
+    // start of a chunk of a long line, there's no newline to join,
+    // just delete the last char of the previous chunk
+    erow *prev = &E.row[E.cy - 1];
+    editorRowWarm(prev);
+    size_t start = editorRowPrevChar(prev, prev->size);
+    editorRowDelString(prev, start, prev->size - start);
+    if (prev->size == 0)
+    {
+      editorDelChunk(E.cy - 1);
+      E.cy--;
+    }
+  }
+  else
+  {
+    // handling case where cursor is at the begginning of a line and we need to
+    // move all the current row onto the end of the row before it
+    E.cx = E.row[E.cy - 1].size;
+    editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+    editorRowSetCont(&E.row[E.cy - 1], E.row[E.cy].cont);
+    editorDelRow(E.cy);
+    E.cy--;
+    editorRowFitChunks(E.cy);
+  }
+}
+
+// insert a run of text at the cursor, a row at a time rather than a char at a time
+void editorInsertText(const char *s, size_t len)
+{
+  while (len > 0)
+  {
+    const char *nl = memchr(s, '\n', len);
+    size_t n = nl ? (size_t)(nl - s) : len;
+
+    if (n > 0)
+    {
+      if (E.cy == E.numrows)
+      {
+        editorInsertRow(E.numrows, "", 0);
+      }
+      editorRowInsertString(&E.row[E.cy], E.cx, s, n);
+      E.cx += n;
+      editorRowFitChunks(E.cy);
+    }
+    if (nl)
+    {
+      editorInsertNewline();
+      n++;
+    }
+    s += n;
+    len -= n;
+  }
+}
+
+/**
+ * Replace every match in the buffer in one pass. Each row with matches
+ * is rebuilt once and re-rendered once, rows without any aren't touched,
+ * and the whole thing is recorded as a single compact OP_REPLACE.
+ * Returns how many were replaced.
+ */
+size_t editorReplaceAll(const char *query, size_t qlen, const char *with, size_t wlen)
+{
+  if (qlen == 0)
+  {
+    return 0;
+  }
+
+  struct replaceRec rec;
+  editorReplaceRecStart(&rec, query, qlen, with, wlen);
+
+  size_t *at = NULL;
+  size_t atcap = 0;
+  size_t count = 0;
+  size_t last = 0;
+  for (size_t y = 0; y < E.numrows; y++)
+  {
+    erow *row = &E.row[y];
+    const char *text = editorRowText(row); // frozen rows are only warmed if they match
+    size_t n = 0;
+    const char *match;
+    size_t pos = 0;
+    while (pos + qlen <= row->size &&
+           (match = memmem(&text[pos], row->size - pos, query, qlen)) != NULL)
+    {
+      if (n == atcap)
+      {
+        size_t *grown = realloc(at, sizeof(size_t) * (atcap ? atcap * 2 : 16));
+        if (grown == NULL)
+        {
+          die("realloc");
+        }
+        at = grown;
+        atcap = atcap ? atcap * 2 : 16;
+      }
+      at[n++] = match - text;
+      pos = at[n - 1] + qlen;
+    }
+    if (n == 0)
+    {
+      continue;
+    }
+
+    editorReplaceRecRow(&rec, y, at, n);
+    editorRowReplaceAt(row, at, n, qlen, with, wlen);
+    last = y;
+    count += n;
+  }
+  free(at);
+
+  size_t first = rec.first;
+  size_t firstcol = rec.firstcol;
+  editorReplaceRecDone(&rec);
+
+  if (count)
+  {
+    // rows that grew too big split into chunks, from the bottom up so the
+    // row numbers above stay put
+    for (size_t y = last + 1; y-- > first;)
+    {
+      editorRowFitChunks(y);
+    }
+    // cursor goes to the first replacement, same place undo puts it
+    E.cy = first;
+    E.cx = firstcol;
+  }
+
+  if (E.cy < E.numrows && E.cx > E.row[E.cy].size)
+  {
+    E.cx = E.row[E.cy].size;
+  }
+  return count;
+}
+
+// status after a replace-all, saying what undo had to give up for it
+void editorReplaceStatus(size_t count)
+{
+  int dropped = 0; // the oversize record at the start of the arena is this one
+  if (E.undo.over && E.undo.len > 0)
+  {
+    editorOp op;
+    memcpy(&op, E.undo.buf, sizeof(op));
+    dropped = op.group == E.undo.group;
+  }
+
+  if (count && !E.undo.paused && E.undo.lost == E.undo.group)
+  {
+    editorSetStatusMessage("%zu replaced, too big to undo", count);
+  }
+  else if (count && dropped)
+  {
+    editorSetStatusMessage("%zu replaced, older undo history dropped to fit it", count);
+  }
+  else
+  {
+    editorSetStatusMessage("%zu replaced", count);
+  }
+}
+
+/*** file i/o ***/
+
+/**
+ * Bulk loader - splits text fed to it in blocks of any size into rows,
+ * long lines into chunk rows, and inserts them at 'at' a batch at a
+ * time so the row array is grown and shifted once per batch rather
+ * than once per line. Loading isn't recorded, callers pause undo and
+ * the journal around it.
+ */
+struct lineLoader
+{
+  size_t at;     // row the next batch goes in at
+  char *carry;   // start of a line split across two blocks
+  size_t clen;
+  size_t ccap;
+  char **chars;  // rows waiting to be inserted
+  size_t *lens;
+  char *cont;
+  size_t n;
+  size_t cap;
+  int exact;     // every line ended in a plain \n
+};
+
+void editorLoaderInit(struct lineLoader *ld, size_t at)
+{
+  memset(ld, 0, sizeof(*ld));
+  ld->at = at;
+  ld->exact = 1;
+}
+
+void editorLoaderFlush(struct lineLoader *ld)
+{
+  if (ld->n == 0)
+  {
+    return;
+  }
+  editorInsertRowsText(ld->at, ld->chars, ld->lens, ld->n);
+  for (size_t i = 0; i < ld->n; i++)
+  {
+    E.row[ld->at + i].cont = ld->cont[i];
+  }
+  ld->at += ld->n;
+  ld->n = 0;
+  editorColdPoll(SIZE_MAX); // a file bigger than the budget is compressed as it comes in
+  editorEvictPoll(SIZE_MAX);
+}
+
+void editorLoaderQueue(struct lineLoader *ld, const char *s, size_t len, int cont)
+{
+  if (ld->n == ld->cap)
+  {
+    size_t cap = ld->cap ? ld->cap * 2 : 256;
+    char **newchars = realloc(ld->chars, sizeof(char *) * cap);
+    if (newchars == NULL)
+    {
+      die("realloc");
+    }
+    ld->chars = newchars;
+    size_t *newlens = realloc(ld->lens, sizeof(size_t) * cap);
+    if (newlens == NULL)
+    {
+      die("realloc");
+    }
+    ld->lens = newlens;
+    char *newcont = realloc(ld->cont, cap);
+    if (newcont == NULL)
+    {
+      die("realloc");
+    }
+    ld->cont = newcont;
+    ld->cap = cap;
+  }
+  char *chars = editorTextAlloc(len + 1);
+  memcpy(chars, s, len);
+  chars[len] = '\0';
+  ld->chars[ld->n] = chars;
+  ld->lens[ld->n] = len;
+  ld->cont[ld->n] = cont;
+  if (++ld->n == KILO_LOAD_BATCH)
+  {
+    editorLoaderFlush(ld);
+  }
+}
+
+// one line without its \n, 'newline' says whether it had one
+void editorLoaderLine(struct lineLoader *ld, const char *s, size_t len, int newline)
+{
+  // \r\n endings or a missing final newline change the layout when we save
+  if (!newline || (len > 0 && s[len - 1] == '\r'))
+  {
+    ld->exact = 0;
+  }
+  while (len > 0 && s[len - 1] == '\r')
+  {
+    len--;
+  }
+  // very long lines are stored as a chain of chunk rows
+  size_t off = 0;
+  do
+  {
+    size_t n = editorChunkLen(&s[off], len - off);
+    editorLoaderQueue(ld, &s[off], n, off + n < len);
+    off += n;
+  } while (off < len);
+}
+
+void editorLoaderFeed(struct lineLoader *ld, const char *buf, size_t len)
+{
+  const char *end = buf + len;
+  const char *nl;
+  while ((nl = memchr(buf, '\n', end - buf)) != NULL)
+  {
+    if (ld->clen)
+    {
+      // finish the line the last block left off in
+      size_t more = nl - buf;
+      if (ld->clen + more > ld->ccap)
+      {
+        char *carry = realloc(ld->carry, ld->clen + more);
+        if (carry == NULL)
+        {
+          die("realloc");
+        }
+        ld->carry = carry;
+        ld->ccap = ld->clen + more;
+      }
+      memcpy(&ld->carry[ld->clen], buf, more);
+      editorLoaderLine(ld, ld->carry, ld->clen + more, 1);
+      ld->clen = 0;
+    }
+    else
+    {
+      editorLoaderLine(ld, buf, nl - buf, 1);
+    }
+    buf = nl + 1;
+  }
+
+  // keep the partial line for the next block
+  size_t rest = end - buf;
+  if (rest)
+  {
+    if (ld->clen + rest > ld->ccap)
+    {
+      char *carry = realloc(ld->carry, (ld->clen + rest) * 2);
+      if (carry == NULL)
+      {
+        die("realloc");
+      }
+      ld->carry = carry;
+      ld->ccap = (ld->clen + rest) * 2;
+    }
+    memcpy(&ld->carry[ld->clen], buf, rest);
+    ld->clen += rest;
+  }
+}
+
+// insert whatever is left, returns the row after the last one loaded
+size_t editorLoaderFinish(struct lineLoader *ld)
+{
+  if (ld->clen)
+  {
+    editorLoaderLine(ld, ld->carry, ld->clen, 0);
+  }
+  editorLoaderFlush(ld);
+  free(ld->carry);
+  free(ld->chars);
+  free(ld->lens);
+  free(ld->cont);
+  return ld->at;
+}
+
+/**
+ * Map a regular file read-only. An empty file gives a NULL map and
+ * length 0. Returns -1 if it can't be opened or isn't a regular file.
+ */
+int editorMapFile(const char *path, char **map, size_t *len)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+  {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+  {
+    close(fd);
+    return -1;
+  }
+  *len = st.st_size;
+  *map = NULL;
+  if (*len)
+  {
+    *map = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (*map == MAP_FAILED)
+    {
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd); // the mapping stays valid
+  return 0;
+}
+
+void editorUnmapFile(char *map, size_t len)
+{
+  if (map)
+  {
+    munmap(map, len);
+  }
+}
+
+/**
+ * Convert arrow structs into a single string
+ * that can be written to file
+ */
+// bytes the rows from 'from' on take in the file
+size_t editorRowsLength(size_t from)
+{
+  size_t totlen = 0;
+  // add up lengths of each row
+  for (size_t j = from; j < E.numrows; j++)
+  {
+    totlen += E.row[j].size + !E.row[j].cont; //+1 for bewline char
+  }
+  return totlen;
+}
+
+/**
+ * Copy the rows' text out as it goes in the file, a buffer at a time,
+ * so a save never needs a second copy of the whole file in memory.
+ * (*y, *x) is where the copy is up to, returns 0 once it's past the end.
+ */
+size_t editorRowsFill(size_t *y, size_t *x, char *buf, size_t cap)
+{
+  size_t n = 0;
+  while (n < cap && *y < E.numrows)
+  {
+    erow *row = &E.row[*y];
+    if (*x < row->size)
+    {
+      size_t take = row->size - *x < cap - n ? row->size - *x : cap - n;
+      memcpy(&buf[n], editorRowText(row) + *x, take);
+      n += take;
+      *x += take;
+      continue;
+    }
+    if (!row->cont)
+    {
+      buf[n++] = '\n'; // append new line to end of row, chunks of a long line don't get one
+    }
+    (*y)++;
+    *x = 0;
+  }
+  return n;
+}
+
+void editorOpen(char *filename)
+{
+  editorTraceBegin("open", SIZE_MAX);
+  free(E.filename);
+  E.filename = strdup(filename); // strdup comes from string.h
+  // makes copy of given string, allocating required memory and assuming you will free the memory
+
+  // Check the file type
+  editorSelectSyntaxHighlight();
+
+  E.undo.paused = 1; // loading the file isn't something to undo
+  E.journal.paused = 1;
+
+  // regular files are read through a mapping, which also gives change
+  // detection its checksums, anything else (a pipe, a device) is read in blocks
+  struct lineLoader ld;
+  editorLoaderInit(&ld, E.numrows);
+  char *map;
+  size_t len;
+  E.gzip = 0;
+#ifdef KILO_ZLIB
+  if (editorIsGzip(filename))
+  {
+    // inflated straight into the loader, seek points are saved for --view on the way
+    E.gzip = 1;
+    if (editorGzScan(filename, &ld, KILO_GZ_SPAN) == -1)
+    {
+      editorSetStatusMessage("%s is damaged or cut short, loaded what could be read", filename);
+    }
+  }
+  else
+#endif
+  if (editorMapFile(filename, &map, &len) == 0)
+  {
+    if (map)
+    {
+      madvise(map, len, MADV_SEQUENTIAL);
+      editorLoaderFeed(&ld, map, len);
+    }
+    if (!E.batch)
+    {
+      editorWatchStart(map, len);
+    }
+    editorUnmapFile(map, len);
+  }
+  else
+  {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+      die("open");
+    }
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0)
+    {
+      if (n == -1)
+      {
+        if (errno == EINTR)
+        {
+          continue; // a resize, SIGWINCH doesn't restart reads
+        }
+        editorSetStatusMessage("Error reading %s: %s, loaded what could be read", filename, strerror(errno));
+        break;
+      }
+      editorLoaderFeed(&ld, buf, n);
+    }
+    close(fd);
+  }
+  editorLoaderFinish(&ld);
+  E.disk_exact = ld.exact && !E.gzip; // offsets in a .gz aren't offsets in the text
+  E.undo.paused = E.batch; // batch edits are neither undoable nor journaled
+  E.journal.paused = E.batch;
+  E.dirty = 0; // resetting on new load
+  E.dirty_row = SIZE_MAX;
+  editorTraceEnd("open");
+
+  if (E.batch)
+  {
+    editorJournalStamp(E.filename); // lets the save be incremental
+    return;
+  }
+
+  // replay edits left behind by a crashed session
+  editorJournalRecover();
+}
+
+/**
+ * write() may return early (Linux caps a single call just under 2GB),
+ * so keep writing until the whole buffer is on disk
+ */
+int editorWriteAll(int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = write(fd, buf, len);
+    if (n == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// same as editorWriteAll, but at a given offset in the file
+int editorPwriteAll(int fd, const char *buf, size_t len, off_t offset)
+{
+  while (len > 0)
+  {
+    ssize_t n = pwrite(fd, buf, len, offset);
+    if (n == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+// write the rows from (y, x) on into fd at 'offset', returns bytes written or -1
+ssize_t editorRowsWrite(int fd, size_t y, size_t x, off_t offset)
+{
+  char *buf = malloc(KILO_SAVE_BUF);
+  if (buf == NULL)
+  {
+    return -1;
+  }
+  off_t start = offset;
+  size_t n;
+  while ((n = editorRowsFill(&y, &x, buf, KILO_SAVE_BUF)) > 0)
+  {
+    if (editorPwriteAll(fd, buf, n, offset) == -1)
+    {
+      free(buf);
+      return -1;
+    }
+    offset += n;
+  }
+  free(buf);
+  return offset - start;
+}
+
+// editorSaveAtomic's contents for a plain file
+int editorSaveRows(int fd)
+{
+  return editorRowsWrite(fd, 0, 0, 0) == -1 ? -1 : 0;
+}
+
+/**
+ * Only rewrite the file from the first changed byte onwards.
+ * Returns bytes written, or -1 if the whole file has to be written instead.
+ */
+ssize_t editorSaveIncremental()
+{
+  // only safe if the file on disk is still exactly the one we loaded / saved
+  struct stat st;
+  if (!E.disk_exact || stat(E.filename, &st) == -1 || E.journal.orig_mtime == 0 ||
+      st.st_size != E.journal.orig_size || st.st_mtim.tv_sec != E.journal.orig_mtime ||
+      st.st_mtim.tv_nsec != E.journal.orig_mtime_ns ||
+      st.st_ino != E.journal.orig_ino || st.st_dev != E.journal.orig_dev)
+  {
+    return -1;
+  }
+
+  size_t from = (E.dirty_row < E.numrows) ? E.dirty_row : E.numrows;
+  size_t col = (from < E.numrows && E.dirty_col <= E.row[from].size) ? E.dirty_col : 0;
+
+  // byte offset where the unchanged part of the file ends
+  off_t offset = 0;
+  for (size_t j = 0; j < from; j++)
+  {
+    offset += E.row[j].size + !E.row[j].cont;
+  }
+  offset += col;
+
+  int fd = open(E.filename, O_RDWR);
+  if (fd == -1)
+  {
+    return -1;
+  }
+
+  ssize_t written = editorRowsWrite(fd, from, col, offset);
+  if (written != -1 && ftruncate(fd, offset + written) == -1)
+  {
+    written = -1;
+  }
+  close(fd);
+  return written;
+}
+
+/**
+ * Crash safe save - write everything to a temp file beside the original,
+ * flush it to disk, then rename it over the original in one step.
+ * 'fill' puts the contents into the temp file, see editorSaveRows.
+ */
+int editorSaveAtomic(int (*fill)(int fd))
+{
+  size_t tmplen = strlen(E.filename) + sizeof(".kilotmpXXXXXX");
+  char *tmp = malloc(tmplen);
+  snprintf(tmp, tmplen, "%s.kilotmpXXXXXX", E.filename);
+
+  int fd = mkstemp(tmp);
+  if (fd == -1)
+  {
+    free(tmp);
+    return -1;
+  }
+
+  // keep the permissions the original file had
+  struct stat st;
+  fchmod(fd, (stat(E.filename, &st) == 0) ? (st.st_mode & 07777) : 0644);
+
+  if (fill(fd) == -1 || fsync(fd) == -1 ||
+      close(fd) == -1 || rename(tmp, E.filename) == -1)
+  {
+    int saved_errno = errno;
+    unlink(tmp);
+    free(tmp);
+    errno = saved_errno;
+    return -1;
+  }
+  free(tmp);
+  return 0;
+}
+
+void editorSave()
+{
+  // if new file
+  if (E.filename == NULL)
+  {
+    E.filename = editorPrompt("Save as: %s (ESC to cancel)", NULL);
+    if (E.filename == NULL)
+    {
+      editorSetStatusMessage("Save aborted");
+      return;
+    }
+    editorSelectSyntaxHighlight();
+  }
+
+#ifdef KILO_ZLIB
+  // compressed files go back compressed, always written whole
+  if (E.gzip)
+  {
+    size_t len = editorRowsLength(0);
+    if (editorGzSave() == -1)
+    {
+      editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+      return;
+    }
+    E.dirty = 0;
+    E.dirty_row = SIZE_MAX;
+    editorJournalDiscard();
+    editorSetStatusMessage("%zu bytes compressed to disk", len);
+    return;
+  }
+#endif
+
+  if (!E.safe_save)
+  {
+    ssize_t written = editorSaveIncremental();
+    if (written != -1)
+    {
+      E.dirty = 0;
+      E.dirty_row = SIZE_MAX;
+      E.disk_exact = 1;
+      editorJournalDiscard();
+      editorWatchSaved();
+      editorSetStatusMessage("%zd bytes written to disk", written);
+      return;
+    }
+  }
+
+  size_t len = editorRowsLength(0);
+
+  if (E.safe_save)
+  {
+    if (editorSaveAtomic(editorSaveRows) == 0)
+    {
+      E.dirty = 0;
+      E.dirty_row = SIZE_MAX;
+      E.disk_exact = 1;
+      editorJournalDiscard();
+      editorWatchSaved();
+      editorSetStatusMessage("%zu bytes written to disk", len);
+      return;
+    }
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    return;
+  }
+
+  // open (or create if it doesn't exist) for reading
+  int fd = open(E.filename, O_RDWR | O_CREAT, 0644); // 0644 is the permissions
+
+  // error checking
+  if (fd != -1)
+  {
+    if (ftruncate(fd, len) != -1)
+    { // sets file size to specific length
+      // write the rows to path E.filename
+      if (editorRowsWrite(fd, 0, 0, 0) != -1)
+      {
+        close(fd);
+        E.dirty = 0; // resetting on save
+        E.dirty_row = SIZE_MAX;
+        E.disk_exact = 1;
+        editorJournalDiscard(); // file on disk has everything now
+        editorWatchSaved();
+        editorSetStatusMessage("%zu bytes written to disk", len);
+        return;
+      }
+    }
+    close(fd);
+  }
+
+  editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+}
+
+/*** crash recovery journal ***/
+
+uint64_t editorNowMs()
+{
+  return editorNowNs() / 1000000;
+}
+
+// files kept beside the file are hidden: dir/name -> dir/.name<ext>
+char *editorSidecarPath(const char *filename, const char *ext)
+{
+  const char *base = strrchr(filename, '/');
+  size_t dirlen = base ? (size_t)(base - filename) + 1 : 0;
+  base = base ? base + 1 : filename;
+
+  size_t len = dirlen + 1 + strlen(base) + strlen(ext) + 1;
+  char *path = malloc(len);
+  snprintf(path, len, "%.*s.%s%s", (int)dirlen, filename, base, ext);
+  return path;
+}
+
+// swap file lives next to the file: dir/name -> dir/.name.kswp
+char *editorJournalPath(const char *filename)
+{
+  return editorSidecarPath(filename, ".kswp");
+}
+
+// remember which version of the file on disk the journal applies to
+void editorJournalStamp(const char *filename)
+{
+  // a new starting point, recovery can't rebuild a clipboard copied before it
+  editorClipRelease(E.journal.clip);
+  E.journal.clip = NULL;
+  E.journal.clip_deferred = 0;
+
+  struct stat st;
+  if (stat(filename, &st) == 0)
+  {
+    E.journal.orig_size = st.st_size;
+    E.journal.orig_mtime = st.st_mtim.tv_sec;
+    E.journal.orig_mtime_ns = st.st_mtim.tv_nsec;
+    E.journal.orig_ino = st.st_ino;
+    E.journal.orig_dev = st.st_dev;
+  }
+  else
+  {
+    E.journal.orig_size = 0;
+    E.journal.orig_mtime = 0;
+    E.journal.orig_mtime_ns = 0;
+    E.journal.orig_ino = 0;
+    E.journal.orig_dev = 0;
+  }
+}
+
+// create the swap file on the first edit, header says which file it belongs to
+int editorJournalOpen()
+{
+  if (E.journal.fd != -1)
+  {
+    return 0;
+  }
+  if (E.filename == NULL)
+  {
+    return -1; // nothing to recover an unnamed buffer into
+  }
+
+  free(E.journal.path);
+  E.journal.path = editorJournalPath(E.filename);
+  E.journal.fd = open(E.journal.path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (E.journal.fd == -1)
+  {
+    return -1;
+  }
+
+  int64_t stamp[5] = {E.journal.orig_size, E.journal.orig_mtime, E.journal.orig_mtime_ns,
+                      (int64_t)E.journal.orig_ino, (int64_t)E.journal.orig_dev};
+  char header[sizeof(KILO_JOURNAL_MAGIC) - 1 + sizeof(stamp)];
+  memcpy(header, KILO_JOURNAL_MAGIC, sizeof(KILO_JOURNAL_MAGIC) - 1);
+  memcpy(&header[sizeof(KILO_JOURNAL_MAGIC) - 1], stamp, sizeof(stamp));
+  if (editorWriteAll(E.journal.fd, header, sizeof(header)) == -1)
+  {
+    close(E.journal.fd);
+    E.journal.fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+// write out whatever is pending, unless it's still young and small
+void editorJournalFlush(int force)
+{
+  if (E.journal.len == 0)
+  {
+    return;
+  }
+
+  uint64_t now = editorNowMs();
+  if (!force && E.journal.len < KILO_JOURNAL_BATCH &&
+      now - E.journal.last_ms < KILO_JOURNAL_DEBOUNCE_MS &&
+      now - E.journal.first_ms < KILO_JOURNAL_MAX_DELAY_MS)
+  {
+    return;
+  }
+
+  // typing may have grown the records since they were queued, sum them now
+  for (size_t pos = 0; pos < E.journal.len;)
+  {
+    editorOp op;
+    memcpy(&op, &E.journal.pending[pos], sizeof(editorOp));
+    size_t end = pos + sizeof(editorOp) + op.len;
+    uint64_t sum = editorBlockSum(&E.journal.pending[pos], end - pos);
+    memcpy(&E.journal.pending[end], &sum, sizeof(sum));
+    pos = end + sizeof(sum);
+  }
+
+  if (editorJournalOpen() == 0)
+  {
+    editorWriteAll(E.journal.fd, E.journal.pending, E.journal.len);
+  }
+  E.journal.len = 0;
+}
+
+// queue a buffer op for the swap file
+void editorJournalOp(int type, size_t row, size_t col, const char *s, size_t len)
+{
+  if (E.journal.paused || E.filename == NULL)
+  {
+    return;
+  }
+  if (E.journal.clip_deferred)
+  {
+    // a copy made before the first op, see editorJournalClip
+    E.journal.clip_deferred = 0;
+    clipOp c = {E.journal.clip_y1, E.journal.clip_x1, NULL};
+    editorJournalOp(OP_CLIP, E.journal.clip_y0, E.journal.clip_x0, (char *)&c, offsetof(clipOp, clip));
+  }
+
+  uint64_t now = editorNowMs();
+
+  // typing extends the newest pending insert instead of adding a record
+  int merge = 0;
+  if (E.journal.len > 0 && type == OP_INSERT && len == 1)
+  {
+    editorOp last;
+    memcpy(&last, &E.journal.pending[E.journal.last], sizeof(editorOp));
+    merge = (last.type == OP_INSERT && last.row == row && last.col + last.len == col);
+  }
+
+  size_t need = merge ? 1 : sizeof(editorOp) + len + sizeof(uint64_t);
+  if (E.journal.len + need > E.journal.cap)
+  {
+    size_t cap = E.journal.cap ? E.journal.cap : 4096;
+    while (cap < E.journal.len + need)
+    {
+      cap *= 2;
+    }
+    char *new = editorRealloc(MEM_JOURNAL, E.journal.pending, cap);
+    if (new == NULL)
+    {
+      return;
+    }
+    E.journal.pending = new;
+    E.journal.cap = cap;
+  }
+
+  if (merge)
+  {
+    editorOp last;
+    memcpy(&last, &E.journal.pending[E.journal.last], sizeof(editorOp));
+    last.len++;
+    memcpy(&E.journal.pending[E.journal.last], &last, sizeof(editorOp));
+    E.journal.pending[E.journal.len - sizeof(uint64_t)] = *s; // checksum slot moves up one
+    E.journal.len++;
+  }
+  else
+  {
+    editorOp op;
+    memset(&op, 0, sizeof(op)); // no stray padding bytes in the file
+    op.type = type;
+    op.row = row;
+    op.col = col;
+    op.len = len;
+    if (E.journal.len == 0)
+    {
+      E.journal.first_ms = now;
+    }
+    E.journal.last = E.journal.len;
+    memcpy(&E.journal.pending[E.journal.len], &op, sizeof(editorOp));
+    memcpy(&E.journal.pending[E.journal.len + sizeof(editorOp)], s, len);
+    E.journal.len += need;
+  }
+  E.journal.last_ms = now;
+
+  // keep recovery latency bounded even while someone types non-stop
+  editorJournalFlush(0);
+}
+
+// buffer matches the file on disk again, the swap file is no longer needed
+void editorJournalDiscard()
+{
+  E.journal.len = 0;
+  if (E.journal.fd != -1)
+  {
+    close(E.journal.fd);
+    E.journal.fd = -1;
+    unlink(E.journal.path);
+  }
+  if (E.filename)
+  {
+    editorJournalStamp(E.filename);
+  }
+}
+
+/**
+ * Look for a swap file left by a session that died with unsaved edits
+ * and offer to replay it on top of the freshly loaded file
+ */
+void editorJournalRecover()
+{
+  editorJournalStamp(E.filename);
+
+  char *path = editorJournalPath(E.filename);
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+  {
+    free(path);
+    return;
+  }
+
+  struct stat st;
+  char *buf = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    buf = malloc(st.st_size);
+    if (buf && read(fd, buf, st.st_size) != st.st_size)
+    {
+      free(buf);
+      buf = NULL;
+    }
+  }
+  close(fd);
+
+  int64_t stamp[5]; // size, mtime, mtime ns, inode, device, see editorJournalOpen
+  size_t hlen = sizeof(KILO_JOURNAL_MAGIC) - 1 + sizeof(stamp);
+  if (buf == NULL || (size_t)st.st_size < hlen ||
+      memcmp(buf, KILO_JOURNAL_MAGIC, sizeof(KILO_JOURNAL_MAGIC) - 1) != 0)
+  {
+    free(buf);
+    free(path);
+    return;
+  }
+  memcpy(stamp, &buf[sizeof(KILO_JOURNAL_MAGIC) - 1], sizeof(stamp));
+
+  if (stamp[0] != E.journal.orig_size || stamp[1] != E.journal.orig_mtime ||
+      stamp[2] != E.journal.orig_mtime_ns || stamp[3] != (int64_t)E.journal.orig_ino ||
+      stamp[4] != (int64_t)E.journal.orig_dev)
+  {
+    // the file changed since the journal was written, replaying would corrupt it
+    size_t oldlen = strlen(path) + 5;
+    char *old = malloc(oldlen);
+    snprintf(old, oldlen, "%s.old", path);
+    rename(path, old);
+    editorSetStatusMessage("Stale swap file moved to %s", old);
+    free(old);
+    free(buf);
+    free(path);
+    return;
+  }
+
+  char *answer = editorPrompt("Unsaved changes found in swap file, recover them? (y/n) %s", NULL);
+  int recover = answer && (answer[0] == 'y' || answer[0] == 'Y');
+  free(answer);
+
+  if (!recover)
+  {
+    unlink(path);
+    free(buf);
+    free(path);
+    return;
+  }
+
+  // replay every complete op, stop at the first torn or zero-filled one
+  size_t pos = hlen;
+  size_t ops = 0;
+  E.journal.paused = 1;
+  while (pos + sizeof(editorOp) + sizeof(uint64_t) <= (size_t)st.st_size)
+  {
+    editorOp op;
+    memcpy(&op, &buf[pos], sizeof(editorOp));
+    if (op.len > (size_t)st.st_size - pos - sizeof(editorOp) - sizeof(uint64_t))
+    {
+      break;
+    }
+    size_t end = pos + sizeof(editorOp) + op.len;
+    uint64_t sum;
+    memcpy(&sum, &buf[end], sizeof(sum));
+    if (sum != editorBlockSum(&buf[pos], end - pos))
+    {
+      break;
+    }
+    E.undo.group++;
+    editorApplyOp(&op, &buf[pos + sizeof(editorOp)], 0);
+    pos = end + sizeof(sum);
+    ops += op.type != OP_CLIP && op.type != OP_CLIP_TEXT; // copies aren't edits
+  }
+  E.journal.paused = 0;
+  if (E.clip.data)
+  {
+    E.journal.clip = E.clip.data; // what was replayed is what's on the clipboard now
+    E.clip.data->refs++;
+  }
+
+  // keep appending to the same swap file, so a second crash loses nothing
+  free(E.journal.path);
+  E.journal.path = path;
+  E.journal.fd = open(path, O_WRONLY | O_APPEND);
+  if (E.journal.fd != -1 && (off_t)pos < st.st_size)
+  {
+    ftruncate(E.journal.fd, pos); // drop the torn record
+  }
+  free(buf);
+
+  E.cx = 0;
+  E.cy = 0;
+  editorSetStatusMessage("Recovered %zu edits from swap file", ops);
+}
+
+/*** gzip ***/
+
+#ifdef KILO_ZLIB
+
+/**
+ * .gz files are inflated straight into the bulk loader a block at a
+ * time, nothing is written to disk first. While inflating, a seek
+ * point is taken every KILO_GZ_SPAN bytes of output at a deflate block
+ * boundary: where it is in both streams plus the 32K of output before
+ * it, which is all inflate needs to start there (as in zlib's zran.c).
+ * The points go to ".<name>.kgzi" beside the file, so --view can later
+ * jump into the middle of it without inflating everything before.
+ */
+
+#define GZ_WINDOW 32768
+#define GZ_MAGIC "KILOGZI1"
+
+// one seek point as stored in the index, its window follows it
+typedef struct gzPoint
+{
+  uint64_t out; // uncompressed offset
+  uint64_t in;  // compressed offset of the first full byte
+  uint32_t bits; // bits of the byte before 'in' that belong to the block, 0-7
+  uint32_t pad;
+} gzPoint;
+
+// index header, the points follow it
+typedef struct gzIndexHeader
+{
+  char magic[8];
+  uint64_t size;  // the .gz file it was made from
+  int64_t mtime;
+  uint64_t total; // uncompressed length
+  uint64_t npoints;
+} gzIndexHeader;
+
+#define GZ_RECORD (sizeof(gzPoint) + GZ_WINDOW)
+
+// 1f 8b at the start, whatever the file is called
+int editorIsGzip(const char *filename)
+{
+  unsigned char magic[2];
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+  {
+    return 0;
+  }
+  int gz = read(fd, magic, 2) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+  close(fd);
+  return gz;
+}
+
+/**
+ * Inflate the whole file once: output goes to 'ld' if there is one,
+ * and seek points to the index file, which is kept if the file inflates
+ * to more than 'index_from' bytes (SIZE_MAX: no index). Returns the
+ * uncompressed length, or -1 if the data is corrupt or cut short.
+ */
+ssize_t editorGzScan(const char *filename, struct lineLoader *ld, size_t index_from)
+{
+  char *map;
+  size_t len;
+  if (editorMapFile(filename, &map, &len) == -1)
+  {
+    return -1;
+  }
+  if (map)
+  {
+    madvise(map, len, MADV_SEQUENTIAL);
+  }
+
+  // points are written as they're taken, the header once the count is known
+  char *path = index_from != SIZE_MAX ? editorSidecarPath(filename, ".kgzi") : NULL;
+  char *tmp = NULL;
+  int fd = -1;
+  if (path)
+  {
+    size_t tmplen = strlen(path) + sizeof(".XXXXXX");
+    tmp = malloc(tmplen);
+    snprintf(tmp, tmplen, "%s.XXXXXX", path);
+    fd = mkstemp(tmp);
+  }
+  gzIndexHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  if (fd != -1 && lseek(fd, sizeof(hdr), SEEK_SET) == -1)
+  {
+    close(fd);
+    unlink(tmp);
+    fd = -1;
+  }
+
+  unsigned char window[GZ_WINDOW];
+  unsigned char record[GZ_RECORD];
+  memset(window, 0, sizeof(window)); // the first point has no history
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  inflateInit2(&strm, 15 + 32); // gzip or zlib header
+  size_t in = 0, out = 0, last = 0;
+  int ret = Z_OK;
+  strm.avail_out = 0;
+  while (in < len || ret == Z_OK)
+  {
+    if (strm.avail_in == 0)
+    {
+      if (in == len)
+      {
+        break;
+      }
+      size_t n = len - in < (1 << 20) ? len - in : (1 << 20);
+      strm.next_in = (unsigned char *)&map[in];
+      strm.avail_in = n;
+      in += n;
+    }
+    if (strm.avail_out == 0)
+    {
+      strm.next_out = window;
+      strm.avail_out = GZ_WINDOW;
+    }
+    unsigned char *from = strm.next_out;
+    ret = inflate(&strm, Z_BLOCK);
+    if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
+    {
+      break;
+    }
+    size_t made = strm.next_out - from;
+    if (ld && made)
+    {
+      editorLoaderFeed(ld, (char *)from, made);
+    }
+    out += made;
+
+    // at a block boundary (and not the end of the stream): a place to start from
+    if (fd != -1 && (strm.data_type & 128) && !(strm.data_type & 64) &&
+        (out == 0 || out - last >= KILO_GZ_SPAN))
+    {
+      gzPoint pt;
+      memset(&pt, 0, sizeof(pt));
+      pt.out = out;
+      pt.in = in - strm.avail_in;
+      pt.bits = strm.data_type & 7;
+      memcpy(record, &pt, sizeof(pt));
+      size_t left = strm.avail_out;
+      memcpy(record + sizeof(pt), window + GZ_WINDOW - left, left);
+      memcpy(record + sizeof(pt) + left, window, GZ_WINDOW - left);
+      if (editorWriteAll(fd, (char *)record, GZ_RECORD) == -1)
+      {
+        close(fd);
+        unlink(tmp);
+        fd = -1;
+      }
+      hdr.npoints++;
+      last = out;
+    }
+
+    if (ret == Z_STREAM_END)
+    {
+      if (strm.avail_in == 0 && in == len)
+      {
+        break;
+      }
+      inflateReset(&strm); // another gzip member follows
+      ret = Z_OK;
+    }
+  }
+  int ok = ret == Z_STREAM_END;
+  inflateEnd(&strm);
+
+  if (fd != -1)
+  {
+    struct stat st;
+    memcpy(hdr.magic, GZ_MAGIC, 8);
+    hdr.total = out;
+    if (ok && out > index_from && stat(filename, &st) == 0)
+    {
+      hdr.size = st.st_size;
+      hdr.mtime = st.st_mtime;
+    }
+    if (hdr.size && pwrite(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) && close(fd) == 0)
+    {
+      rename(tmp, path);
+    }
+    else
+    {
+      close(fd); // small files aren't worth an index, nor is a broken one
+      unlink(tmp);
+    }
+  }
+  free(tmp);
+  free(path);
+  editorUnmapFile(map, len);
+  return ok ? (ssize_t)out : -1;
+}
+
+// --view of a .gz: the compressed file, its seek points and a window of inflated bytes
+struct editorGz
+{
+  char *map; // compressed file
+  size_t len;
+  int fd;    // index, windows are read from it when needed
+  gzPoint *points;
+  size_t npoints;
+  size_t total;
+  z_stream strm;
+  int live;      // strm is positioned at the end of the cache
+  int raw;       // strm started at a seek point, it doesn't expect a gzip header
+  size_t released; // compressed pages before this have been dropped
+  char *cache;   // inflated bytes [start, start + clen)
+  size_t start;
+  size_t clen;
+  size_t ccap;
+};
+
+// load the index if it still matches the file, otherwise inflate once to make
+// it, NULL if the file isn't valid gzip or the index can't be written
+struct editorGz *editorGzOpen(const char *filename)
+{
+  struct stat st;
+  if (stat(filename, &st) == -1)
+  {
+    return NULL;
+  }
+  char *path = editorSidecarPath(filename, ".kgzi");
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    int fd = open(path, O_RDONLY);
+    gzIndexHeader hdr;
+    if (fd != -1 && read(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && !memcmp(hdr.magic, GZ_MAGIC, 8) &&
+        hdr.size == (uint64_t)st.st_size && hdr.mtime == (int64_t)st.st_mtime && hdr.npoints)
+    {
+      struct editorGz *gz = calloc(1, sizeof(*gz));
+      gz->fd = fd;
+      gz->total = hdr.total;
+      gz->npoints = hdr.npoints;
+      gz->points = malloc(sizeof(gzPoint) * hdr.npoints);
+      size_t i;
+      for (i = 0; i < hdr.npoints; i++)
+      {
+        if (pread(fd, &gz->points[i], sizeof(gzPoint), sizeof(hdr) + i * GZ_RECORD) != sizeof(gzPoint))
+        {
+          break;
+        }
+      }
+      if (i == hdr.npoints && editorMapFile(filename, &gz->map, &gz->len) == 0 && gz->map)
+      {
+        free(path);
+        return gz;
+      }
+      free(gz->points);
+      free(gz);
+    }
+    if (fd != -1)
+    {
+      close(fd);
+    }
+    if (attempt == 0 && editorGzScan(filename, NULL, 0) == -1)
+    {
+      editorSetStatusMessage("%s is damaged or cut short, showing it compressed", filename);
+      break;
+    }
+    if (attempt == 1)
+    {
+      editorSetStatusMessage("Can't write %s, showing the file compressed", path);
+    }
+  }
+  free(path);
+  return NULL;
+}
+
+// last seek point at or before 'off'
+size_t editorGzPoint(struct editorGz *gz, size_t off)
+{
+  size_t lo = 0, hi = gz->npoints;
+  while (hi - lo > 1)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (gz->points[mid].out <= off)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// restart inflate at seek point 'i', with the cache empty
+void editorGzRestart(struct editorGz *gz, size_t i)
+{
+  gzPoint *pt = &gz->points[i];
+  unsigned char window[GZ_WINDOW];
+  if (pread(gz->fd, window, GZ_WINDOW, sizeof(gzIndexHeader) + i * GZ_RECORD + sizeof(gzPoint)) != GZ_WINDOW)
+  {
+    memset(window, 0, sizeof(window));
+  }
+
+  if (gz->live)
+  {
+    inflateEnd(&gz->strm);
+  }
+  memset(&gz->strm, 0, sizeof(gz->strm));
+  inflateInit2(&gz->strm, -15); // raw deflate, we're past the header
+  gz->strm.next_in = (unsigned char *)&gz->map[pt->in - (pt->bits ? 1 : 0)];
+  gz->strm.avail_in = gz->len - (pt->in - (pt->bits ? 1 : 0));
+  if (pt->bits)
+  {
+    inflatePrime(&gz->strm, pt->bits, (unsigned char)*gz->strm.next_in >> (8 - pt->bits));
+    gz->strm.next_in++;
+    gz->strm.avail_in--;
+  }
+  inflateSetDictionary(&gz->strm, window, GZ_WINDOW);
+  gz->live = 1;
+  gz->raw = 1;
+  gz->released = pt->in;
+  gz->start = pt->out;
+  gz->clen = 0;
+}
+
+// inflate onto the end of the cache until it reaches 'end' or the cache is full
+void editorGzFill(struct editorGz *gz, size_t end)
+{
+  while (gz->start + gz->clen < end && gz->clen < gz->ccap)
+  {
+    gz->strm.next_out = (unsigned char *)&gz->cache[gz->clen];
+    gz->strm.avail_out = gz->ccap - gz->clen;
+    int ret = inflate(&gz->strm, Z_NO_FLUSH);
+    gz->clen = (char *)gz->strm.next_out - gz->cache;
+    if (ret == Z_STREAM_END)
+    {
+      // another gzip member may follow, a raw stream left its trailer unread
+      if (gz->raw)
+      {
+        size_t skip = gz->strm.avail_in < 8 ? gz->strm.avail_in : 8;
+        gz->strm.next_in += skip;
+        gz->strm.avail_in -= skip;
+        inflateReset2(&gz->strm, 15 + 16);
+        gz->raw = 0;
+      }
+      else
+      {
+        inflateReset(&gz->strm);
+      }
+      if (gz->strm.avail_in == 0)
+      {
+        break;
+      }
+    }
+    else if (ret != Z_OK)
+    {
+      break; // corrupt or cut short, there's no more
+    }
+
+    // like the plain pager, compressed pages already read are dropped
+    size_t in = (char *)gz->strm.next_in - gz->map;
+    if (in - gz->released >= KILO_VIEW_RELEASE)
+    {
+      size_t from = gz->released - gz->released % sysconf(_SC_PAGESIZE);
+      madvise(&gz->map[from], in - from, MADV_DONTNEED);
+      gz->released = in;
+    }
+  }
+}
+
+// inflated bytes [off, off + n), n is at most KILO_VIEW_RELEASE
+const char *editorGzBytes(struct editorGz *gz, size_t off, size_t n)
+{
+  if (off >= gz->start && off + n <= gz->start + gz->clen)
+  {
+    return &gz->cache[off - gz->start];
+  }
+  if (gz->cache == NULL)
+  {
+    gz->ccap = 2 * KILO_VIEW_RELEASE;
+    gz->cache = editorMalloc(MEM_ROWS, gz->ccap);
+    if (gz->cache == NULL)
+    {
+      die("malloc");
+    }
+  }
+
+  // behind us, or a seek point is nearer than where we are: start from it
+  size_t i = editorGzPoint(gz, off);
+  if (!gz->live || off < gz->start || gz->points[i].out > gz->start + gz->clen)
+  {
+    editorGzRestart(gz, i);
+  }
+  for (;;)
+  {
+    // nothing before 'off' is wanted any more
+    if (off > gz->start)
+    {
+      size_t drop = off - gz->start < gz->clen ? off - gz->start : gz->clen;
+      memmove(gz->cache, &gz->cache[drop], gz->clen - drop);
+      gz->start += drop;
+      gz->clen -= drop;
+    }
+    if (gz->start + gz->clen >= off + n)
+    {
+      break;
+    }
+    size_t had = gz->clen;
+    editorGzFill(gz, off + n);
+    if (gz->clen == had)
+    {
+      // the data ended early, pad so the caller still gets its n bytes
+      gz->start = off;
+      memset(&gz->cache[gz->clen], '\n', n - gz->clen);
+      gz->clen = n;
+      gz->live = 0;
+      break;
+    }
+  }
+  return gz->cache;
+}
+
+void editorGzClose(struct editorGz *gz)
+{
+  if (gz->live)
+  {
+    inflateEnd(&gz->strm);
+  }
+  close(gz->fd);
+  editorUnmapFile(gz->map, gz->len);
+  editorFree(MEM_ROWS, gz->cache);
+  free(gz->points);
+  free(gz);
+}
+
+// editorSaveAtomic's contents for a .gz file, the rows deflated a buffer at a time
+int editorGzWrite(int fd)
+{
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return -1;
+  }
+  char *in = malloc(KILO_SAVE_BUF);
+  char *out = malloc(KILO_SAVE_BUF);
+  int ret = in && out ? Z_OK : Z_MEM_ERROR;
+  size_t y = 0, x = 0;
+  while (ret == Z_OK)
+  {
+    size_t n = editorRowsFill(&y, &x, in, KILO_SAVE_BUF);
+    strm.next_in = (unsigned char *)in;
+    strm.avail_in = n;
+    do
+    {
+      strm.next_out = (unsigned char *)out;
+      strm.avail_out = KILO_SAVE_BUF;
+      ret = deflate(&strm, n ? Z_NO_FLUSH : Z_FINISH);
+      if (ret == Z_BUF_ERROR)
+      {
+        ret = Z_OK; // nothing left to do until more input comes
+      }
+      if (ret == Z_STREAM_ERROR || editorWriteAll(fd, out, KILO_SAVE_BUF - strm.avail_out) == -1)
+      {
+        ret = Z_ERRNO;
+        break;
+      }
+    } while (strm.avail_out == 0);
+  }
+  deflateEnd(&strm);
+  free(in);
+  free(out);
+  return ret == Z_STREAM_END ? 0 : -1;
+}
+
+// write the buffer back compressed, through a temp file and rename
+int editorGzSave()
+{
+  if (editorSaveAtomic(editorGzWrite) == -1)
+  {
+    return -1;
+  }
+
+  // the seek points are for the old contents
+  char *path = editorSidecarPath(E.filename, ".kgzi");
+  unlink(path);
+  free(path);
+  return 0;
+}
+
+#endif
+
+/*** external changes ***/
+
+// checksum of one block, a word at a time
+uint64_t editorBlockSum(const char *p, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL ^ len;
+  while (len >= 8)
+  {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = (h ^ w) * 1099511628211ULL;
+    h ^= h >> 29;
+    p += 8;
+    len -= 8;
+  }
+  while (len--)
+  {
+    h = (h ^ (unsigned char)*p++) * 1099511628211ULL;
+  }
+  return h;
+}
+
+// per block checksums of a file's contents, from the start and from the end
+void editorWatchSums(const char *map, size_t len, uint64_t **head, uint64_t **tail, size_t *nblocks)
+{
+  size_t n = (len + KILO_WATCH_BLOCK - 1) / KILO_WATCH_BLOCK;
+  *head = editorMalloc(MEM_WATCH, sizeof(uint64_t) * (n ? n : 1));
+  *tail = editorMalloc(MEM_WATCH, sizeof(uint64_t) * (n ? n : 1));
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t start = i * KILO_WATCH_BLOCK;
+    size_t end = len - start;
+    (*head)[i] = editorBlockSum(&map[start], len - start < KILO_WATCH_BLOCK ? len - start : KILO_WATCH_BLOCK);
+    start = end > KILO_WATCH_BLOCK ? end - KILO_WATCH_BLOCK : 0;
+    (*tail)[i] = editorBlockSum(&map[start], end - start);
+  }
+  *nblocks = n;
+}
+
+// remember what the file on disk looks like now
+void editorWatchSnapshot(const char *map, size_t len)
+{
+  editorFree(MEM_WATCH, E.watch.head);
+  editorFree(MEM_WATCH, E.watch.tail);
+  editorWatchSums(map, len, &E.watch.head, &E.watch.tail, &E.watch.nblocks);
+  E.watch.size = len;
+}
+
+// start watching E.filename, 'map' is its contents as just loaded
+void editorWatchStart(const char *map, size_t len)
+{
+  if (E.watch.fd == -1)
+  {
+    char *slash = strrchr(E.filename, '/');
+    char *dir = slash ? strndup(E.filename, slash == E.filename ? 1 : (size_t)(slash - E.filename)) : strdup(".");
+    E.watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (E.watch.fd != -1 &&
+        inotify_add_watch(E.watch.fd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1)
+    {
+      close(E.watch.fd);
+      E.watch.fd = -1;
+    }
+    free(dir);
+    if (E.watch.fd == -1)
+    {
+      return; // no inotify, the file just won't be reloaded
+    }
+  }
+  free(E.watch.name);
+  char *slash = strrchr(E.filename, '/');
+  E.watch.name = strdup(slash ? slash + 1 : E.filename);
+  editorWatchSnapshot(map, len);
+  E.watch.changed = 0;
+}
+
+// read the queued events, returns 1 if any were about our file
+int editorWatchDrain()
+{
+  uint64_t words[512]; // aligned for struct inotify_event
+  char *buf = (char *)words;
+  int ours = 0;
+  ssize_t n;
+  while ((n = read(E.watch.fd, buf, sizeof(words))) > 0)
+  {
+    for (char *p = buf; p < buf + n;)
+    {
+      struct inotify_event ev;
+      memcpy(&ev, p, sizeof(ev));
+      const char *name = p + sizeof(ev);
+      if ((ev.mask & IN_Q_OVERFLOW) || (ev.len && strcmp(name, E.watch.name) == 0))
+      {
+        ours = 1;
+      }
+      p += sizeof(ev) + ev.len;
+    }
+  }
+  return ours;
+}
+
+// we just wrote the file, so its new contents are what we have
+void editorWatchSaved()
+{
+  if (E.batch)
+  {
+    return;
+  }
+  char *map;
+  size_t len;
+  if (editorMapFile(E.filename, &map, &len) == -1)
+  {
+    return;
+  }
+  editorWatchStart(map, len); // also starts watching a file saved for the first time
+  editorUnmapFile(map, len);
+  if (E.watch.fd != -1)
+  {
+    editorWatchDrain(); // our own writes
+    E.watch.changed = 0;
+  }
+}
+
+/**
+ * The file changed on disk. Skip the blocks at the start and the end
+ * whose checksums still match, widen what's left to whole lines, and
+ * reload just those rows - the rest keep their text, render and
+ * highlighting, and the cursor and scroll position stay on the same text.
+ */
+void editorWatchReload()
+{
+  E.watch.changed = 0;
+  char *map;
+  size_t len;
+  if (editorMapFile(E.filename, &map, &len) == -1)
+  {
+    return; // gone for now, a rename into place will bring it back
+  }
+  if (E.dirty)
+  {
+    editorUnmapFile(map, len);
+    editorSetStatusMessage("%s changed on disk, not reloaded over unsaved changes", E.filename);
+    return;
+  }
+
+  uint64_t *head, *tail;
+  size_t nblocks;
+  editorWatchSums(map, len, &head, &tail, &nblocks);
+
+  size_t oldlen = E.watch.size;
+  size_t common = oldlen < len ? oldlen : len;
+  size_t same = 0; // bytes known to be unchanged at the start
+  size_t i;
+  for (i = 0; i < nblocks && i < E.watch.nblocks && head[i] == E.watch.head[i]; i++)
+  {
+  }
+  same = i * KILO_WATCH_BLOCK;
+  if (oldlen == len && same >= len)
+  {
+    // touched or rewritten with the same contents
+    editorFree(MEM_WATCH, head);
+    editorFree(MEM_WATCH, tail);
+    editorUnmapFile(map, len);
+    return;
+  }
+  same = same > common ? common : same;
+  for (i = 0; i < nblocks && i < E.watch.nblocks && tail[i] == E.watch.tail[i]; i++)
+  {
+  }
+  size_t suffix = i * KILO_WATCH_BLOCK; // ...and at the end
+  suffix = suffix > common - same ? common - same : suffix;
+  if (!E.disk_exact)
+  {
+    same = suffix = 0; // \r\n or a missing newline, rows don't map onto bytes
+  }
+
+  // rows [r0, r1) hold old bytes [o0, o1): whole lines covering the changed bytes,
+  // ending in a newline that's in the unchanged tail
+  size_t q = oldlen - suffix;
+  size_t r0 = E.numrows, r1 = E.numrows, o0 = oldlen, o1 = oldlen;
+  size_t off = 0, line_row = 0, line_off = 0;
+  for (size_t y = 0; y < E.numrows; y++)
+  {
+    if (y == 0 || !E.row[y - 1].cont)
+    {
+      line_row = y;
+      line_off = off;
+    }
+    off += E.row[y].size + !E.row[y].cont;
+    if (r0 == E.numrows && same < off)
+    {
+      r0 = line_row;
+      o0 = line_off;
+    }
+    if (q < off && !E.row[y].cont)
+    {
+      r1 = y + 1;
+      o1 = off;
+      break;
+    }
+  }
+  if (r0 == E.numrows)
+  {
+    o0 = off; // only bytes after the last row changed
+  }
+
+  int undo_paused = E.undo.paused, journal_paused = E.journal.paused;
+  E.undo.paused = 1; // the file changed, not the user's edits
+  E.journal.paused = 1;
+  editorDelRows(r0, r1 - r0);
+  struct lineLoader ld;
+  editorLoaderInit(&ld, r0);
+  editorLoaderFeed(&ld, &map[o0], o1 + len - oldlen - o0);
+  size_t added = editorLoaderFinish(&ld) - r0;
+  E.undo.paused = undo_paused;
+  E.journal.paused = journal_paused;
+  E.disk_exact = ld.exact && (len == 0 || map[len - 1] == '\n');
+
+  // history refers to rows that have moved or gone
+  editorUndoClear();
+  E.dirty = 0;
+  E.dirty_row = SIZE_MAX;
+  editorJournalStamp(E.filename);
+  editorCursorsClear();
+  E.sel.active = 0;
+
+  // rows after the reloaded ones moved by the same amount
+  size_t removed = r1 - r0;
+  if (E.cy >= r1)
+  {
+    E.cy = E.cy - removed + added;
+  }
+  else if (E.cy >= r0 + added)
+  {
+    E.cy = r0 + added ? r0 + added - 1 : 0;
+  }
+  if (E.rowoff >= r1)
+  {
+    E.rowoff = E.rowoff - removed + added;
+  }
+  if (E.cy > E.numrows)
+  {
+    E.cy = E.numrows;
+  }
+  if (E.cy < E.numrows && E.cx > E.row[E.cy].size)
+  {
+    E.cx = E.row[E.cy].size;
+  }
+  else if (E.cy == E.numrows)
+  {
+    E.cx = 0;
+  }
+  if (E.rowoff > E.numrows)
+  {
+    E.rowoff = E.numrows;
+  }
+
+  editorFree(MEM_WATCH, E.watch.head);
+  editorFree(MEM_WATCH, E.watch.tail);
+  E.watch.head = head;
+  E.watch.tail = tail;
+  E.watch.nblocks = nblocks;
+  E.watch.size = len;
+  editorUnmapFile(map, len);
+  editorSetStatusMessage("%s changed on disk, reloaded %zu lines", E.filename, added);
+}
+
+// from editorIdle: collect events, reload once they've settled
+void editorWatchPoll()
+{
+  if (E.watch.fd == -1)
+  {
+    return;
+  }
+  if (E.follow.fd != -1)
+  {
+    editorWatchDrain(); // follow mode is reading the new bytes itself
+    return;
+  }
+  if (editorWatchDrain())
+  {
+    E.watch.changed = 1;
+    E.watch.changed_ms = editorNowMs();
+    return;
+  }
+  // not under an open prompt, the reload waits for it to close
+  if (E.watch.changed && !E.prompting && editorNowMs() - E.watch.changed_ms >= KILO_WATCH_SETTLE_MS)
+  {
+    editorWatchReload();
+    editorRefreshScreen();
+  }
+}
+
+/*** follow mode ***/
+
+// add bytes appended to the file: finish the partial last line, load the rest
+void editorFollowAppend(const char *buf, size_t len)
+{
+  if (E.follow.partial && E.numrows)
+  {
+    const char *nl = memchr(buf, '\n', len);
+    size_t n = nl ? (size_t)(nl - buf) : len;
+    size_t last = E.numrows - 1;
+    erow *row = &E.row[last];
+    editorRowInsertString(row, row->size, buf, n);
+    // a \r\n ending is dropped like the loader does, the \r may have come in the last read
+    while (nl && row->size > 0 && editorRowText(row)[row->size - 1] == '\r')
+    {
+      editorRowDelString(row, row->size - 1, 1);
+    }
+    editorRowFitChunks(last);
+    if (!nl)
+    {
+      return;
+    }
+    E.follow.partial = 0;
+    buf += n + 1;
+    len -= n + 1;
+  }
+  if (len)
+  {
+    struct lineLoader ld;
+    editorLoaderInit(&ld, E.numrows);
+    editorLoaderFeed(&ld, buf, len);
+    editorLoaderFinish(&ld);
+    E.follow.partial = buf[len - 1] != '\n';
+  }
+}
+
+// from editorIdle: load whatever has been written since the last frame
+void editorFollowPoll()
+{
+  if (E.follow.fd == -1 || E.prompting)
+  {
+    return; // the new bytes stay in the file until the prompt closes
+  }
+  struct stat st, path;
+  if (fstat(E.follow.fd, &st) == -1)
+  {
+    return;
+  }
+
+  int undo_paused = E.undo.paused, journal_paused = E.journal.paused;
+  E.undo.paused = 1; // the file grew, the user didn't type it
+  E.journal.paused = 1;
+  int changed = 0;
+
+  // rotated (a new file renamed into place) or truncated: start over on what's there now
+  int rotated = stat(E.filename, &path) == 0 && (path.st_ino != st.st_ino || path.st_dev != st.st_dev);
+  if (rotated || st.st_size < E.follow.offset)
+  {
+    int fd = open(E.filename, O_RDONLY);
+    if (fd != -1 && fstat(fd, &st) == 0)
+    {
+      close(E.follow.fd);
+      E.follow.fd = fd;
+      E.follow.offset = 0;
+      E.follow.partial = 0;
+      editorDelRows(0, E.numrows);
+      E.cy = E.cx = 0;
+      E.rowoff = E.coloff = 0;
+      changed = 1;
+
+      // history, cursors and the mark were on rows that are gone
+      editorUndoClear();
+      editorCursorsClear();
+      E.sel.active = 0;
+      editorSetStatusMessage("%s was %s, following it from the start", E.filename, rotated ? "rotated" : "truncated");
+    }
+    else if (fd != -1)
+    {
+      close(fd);
+    }
+  }
+
+  if (st.st_size > E.follow.offset)
+  {
+    size_t want = st.st_size - E.follow.offset;
+    want = want > KILO_FOLLOW_MAX_READ ? KILO_FOLLOW_MAX_READ : want;
+    char *buf = malloc(want);
+    ssize_t n = buf ? pread(E.follow.fd, buf, want, E.follow.offset) : -1;
+    if (n > 0)
+    {
+      // stay at the bottom if that's where the cursor was
+      int bottom = E.cy + 1 >= E.numrows;
+      editorFollowAppend(buf, n);
+      E.follow.offset += n;
+      changed = 1;
+      if (bottom)
+      {
+        E.cy = E.numrows ? E.numrows - 1 : 0;
+        E.cx = 0;
+      }
+    }
+    free(buf);
+  }
+
+  E.undo.paused = undo_paused;
+  E.journal.paused = journal_paused;
+  if (changed)
+  {
+    E.dirty = 0; // the buffer is still what's on disk
+    E.dirty_row = SIZE_MAX;
+    editorRefreshScreen(); // one frame for everything that came in
+  }
+}
+
+// Ctrl-O / --follow
+void editorFollowStart()
+{
+  if (E.view.active)
+  {
+    editorSetStatusMessage("Can't follow in --view, the pager shows the file as it was opened");
+    return;
+  }
+  if (E.filename == NULL)
+  {
+    editorSetStatusMessage("No file to follow");
+    return;
+  }
+  if (E.dirty)
+  {
+    editorSetStatusMessage("Save before following, new lines go after what's on disk");
+    return;
+  }
+  if (E.gzip)
+  {
+    editorSetStatusMessage("Can't follow a compressed file");
+    return;
+  }
+  // the buffer is the file up to now, only what comes after it is read.
+  // A truncate in between reads nothing, and the next poll starts over.
+  int fd = open(E.filename, O_RDONLY);
+  struct stat st;
+  char last = '\n';
+  if (fd == -1 || fstat(fd, &st) == -1 || (st.st_size > 0 && pread(fd, &last, 1, st.st_size - 1) == -1))
+  {
+    if (fd != -1)
+    {
+      close(fd);
+    }
+    editorSetStatusMessage("Can't follow %s: %s", E.filename, strerror(errno));
+    return;
+  }
+  E.follow.fd = fd;
+  E.follow.offset = st.st_size;
+  E.follow.partial = last != '\n';
+  E.cy = E.numrows ? E.numrows - 1 : 0;
+  E.cx = 0;
+  E.sel.active = 0;
+  editorCursorsClear();
+  editorSetStatusMessage("Following %s (Ctrl-O or any edit stops)", E.filename);
+}
+
+void editorFollowStop()
+{
+  if (E.follow.fd == -1)
+  {
+    return;
+  }
+  editorFollowPoll(); // pick up anything written since the last frame
+  close(E.follow.fd);
+  E.follow.fd = -1;
+
+  // change detection takes over from the file as it is now
+  char *map;
+  size_t len;
+  if (E.watch.fd != -1 && editorMapFile(E.filename, &map, &len) == 0)
+  {
+    editorWatchSnapshot(map, len);
+    editorUnmapFile(map, len);
+  }
+  editorJournalStamp(E.filename);
+  editorSetStatusMessage("Stopped following %s", E.filename);
+}
+
+// keys that move around or only look, anything that edits stops following
+int editorFollowKeeps(int c)
+{
+  return c == CTRL_KEY('o') || (c != CTRL_KEY('x') && editorSelectionKeeps(c));
+}
+
+/*** pager ***/
+
+/**
+ * --view: read-only pager for files too big to load. The file is
+ * mapped, never read into rows: only the rows on screen are built (by
+ * the bulk loader, so they split exactly as a normal open would) and
+ * drawn by editorDrawRows like any others. Rows are found by scanning
+ * the mapping, and the offset of every KILO_VIEW_STRIDE-th one is kept
+ * so any row is a short scan away. Pages are dropped from the mapping
+ * once they've been read, which keeps RSS to a few MB whatever the size
+ * of the file. Opening builds the first screen only; the rest of the
+ * index is filled in while the editor is idle. A .gz file is read the
+ * same way through its seek points, a window of it inflated at a time.
+ */
+
+// bytes [o, o + n) of the file, n is at most KILO_VIEW_RELEASE
+const char *editorViewBytes(size_t o, size_t n)
+{
+#ifdef KILO_ZLIB
+  if (E.view.gz)
+  {
+    return editorGzBytes(E.view.gz, o, n);
+  }
+#endif
+  (void)n;
+  return &E.view.map[o];
+}
+
+// where the row after the one starting at 'o' starts, split like the loader splits
+size_t editorViewNextRow(size_t o)
+{
+  size_t rem = E.view.len - o;
+  size_t scan = rem < KILO_CHUNK_SIZE + 2 ? rem : KILO_CHUNK_SIZE + 2;
+  const char *p = editorViewBytes(o, scan);
+  const char *nl = memchr(p, '\n', scan);
+  if (nl)
+  {
+    size_t len = nl - p;
+    while (len > 0 && p[len - 1] == '\r')
+    {
+      len--;
+    }
+    if (len <= KILO_CHUNK_SIZE)
+    {
+      return o + (nl - p) + 1;
+    }
+  }
+  else if (rem <= KILO_CHUNK_SIZE)
+  {
+    return E.view.len; // last line, no newline after it
+  }
+  // a long line carries on in the next row
+  return o + editorChunkLen(p, KILO_CHUNK_SIZE + 1);
+}
+
+// drop the pages of [from, to) from the mapping, they're read back if needed again
+void editorViewRelease(size_t from, size_t to)
+{
+  if (E.view.gz)
+  {
+    return; // nothing mapped, the inflated window is reused
+  }
+  size_t page = sysconf(_SC_PAGESIZE);
+  from -= from % page;
+  if (to > from)
+  {
+    madvise(&E.view.map[from], to - from, MADV_DONTNEED);
+  }
+}
+
+// find more rows, until there are 'want' of them or 'budget' bytes have been scanned
+void editorViewScan(size_t want, size_t budget)
+{
+  size_t start = E.view.scanned;
+  size_t released = start;
+  while (!E.view.eof && E.view.rows < want && E.view.scanned - start < budget)
+  {
+    if (E.view.scanned - released >= KILO_VIEW_RELEASE)
+    {
+      editorViewRelease(released, E.view.scanned);
+      released = E.view.scanned;
+    }
+    if (E.view.scanned >= E.view.len)
+    {
+      E.view.eof = 1;
+      break;
+    }
+    if (E.view.rows % KILO_VIEW_STRIDE == 0)
+    {
+      if (E.view.nindex == E.view.cap)
+      {
+        E.view.cap = E.view.cap ? E.view.cap * 2 : 1024;
+        E.view.index = editorRealloc(MEM_ROWS, E.view.index, sizeof(size_t) * E.view.cap);
+        if (E.view.index == NULL)
+        {
+          die("realloc");
+        }
+      }
+      E.view.index[E.view.nindex++] = E.view.scanned;
+    }
+    E.view.scanned = editorViewNextRow(E.view.scanned);
+    E.view.rows++;
+  }
+  if (E.view.scanned >= E.view.len)
+  {
+    E.view.eof = 1;
+  }
+  editorViewRelease(released, E.view.scanned);
+}
+
+// offset of row *r, which is pulled back to the last row if there aren't that many
+size_t editorViewSeek(size_t *r)
+{
+  editorViewScan(*r + 1, SIZE_MAX);
+  if (*r >= E.view.rows)
+  {
+    *r = E.view.rows ? E.view.rows - 1 : 0;
+  }
+  if (E.view.rows == 0)
+  {
+    return 0;
+  }
+  size_t o = E.view.index[*r / KILO_VIEW_STRIDE];
+  for (size_t i = 0; i < *r % KILO_VIEW_STRIDE; i++)
+  {
+    o = editorViewNextRow(o);
+  }
+  return o;
+}
+
+// row holding byte 'off', and where that row starts
+size_t editorViewRowAt(size_t off, size_t *start)
+{
+  while (!E.view.eof && E.view.scanned <= off)
+  {
+    editorViewScan(E.view.rows + KILO_VIEW_STRIDE, SIZE_MAX);
+  }
+  size_t lo = 0, hi = E.view.nindex;
+  while (hi - lo > 1)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (E.view.index[mid] <= off)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  size_t r = lo * KILO_VIEW_STRIDE;
+  size_t o = E.view.index[lo];
+  size_t next;
+  while ((next = editorViewNextRow(o)) <= off && next < E.view.len)
+  {
+    o = next;
+    r++;
+  }
+  *start = o;
+  return r;
+}
+
+// build the rows for a screen starting at row 'top'
+void editorViewFill(size_t top)
+{
+  size_t o0 = editorViewSeek(&top);
+  size_t o1 = o0;
+  for (int n = 0; n < E.screenrows && o1 < E.view.len; n++)
+  {
+    o1 = editorViewNextRow(o1);
+  }
+
+  editorDelRows(0, E.numrows);
+  struct lineLoader ld;
+  editorLoaderInit(&ld, 0);
+  for (size_t o = o0; o < o1;)
+  {
+    size_t n = o1 - o < KILO_VIEW_RELEASE ? o1 - o : KILO_VIEW_RELEASE;
+    editorLoaderFeed(&ld, editorViewBytes(o, n), n);
+    o += n;
+  }
+  editorLoaderFinish(&ld);
+  editorViewRelease(o0, o1);
+
+  E.view.top = top;
+  E.view.more = o1 < E.view.len;
+  E.dirty = 0;
+  E.rowoff = 0;
+  if (E.cy >= E.numrows)
+  {
+    E.cy = E.numrows ? E.numrows - 1 : 0;
+  }
+  if (E.cy < E.numrows && E.cx > E.row[E.cy].size)
+  {
+    E.cx = E.row[E.cy].size;
+  }
+}
+
+void editorViewOpen(char *filename)
+{
+  free(E.filename);
+  E.filename = strdup(filename);
+  editorSelectSyntaxHighlight();
+#ifdef KILO_ZLIB
+  if (editorIsGzip(filename))
+  {
+    // the first time this inflates the whole file to make the seek points
+    E.view.gz = editorGzOpen(filename);
+    if (E.view.gz)
+    {
+      E.view.len = E.view.gz->total;
+    }
+  }
+  if (E.view.gz == NULL)
+#endif
+  if (editorMapFile(filename, &E.view.map, &E.view.len) == -1)
+  {
+    die("open");
+  }
+  E.view.active = 1;
+  E.undo.paused = 1; // nothing is ever edited
+  E.journal.paused = 1;
+  editorViewFill(0);
+}
+
+// search forward from just after the cursor, straight through the mapping
+void editorViewSearch()
+{
+  if (E.view.query == NULL || E.numrows == 0)
+  {
+    return;
+  }
+  size_t r = E.view.top + E.cy;
+  size_t from = editorViewSeek(&r) + E.cx + 1;
+  from = from > E.view.len ? E.view.len : from;
+  size_t qlen = strlen(E.view.query);
+  size_t off = SIZE_MAX;
+  // a window at a time, overlapping so a match across the boundary is found
+  while (off == SIZE_MAX && from + qlen <= E.view.len)
+  {
+    size_t n = E.view.len - from < KILO_VIEW_RELEASE ? E.view.len - from : KILO_VIEW_RELEASE;
+    const char *w = editorViewBytes(from, n);
+    const char *m = memmem(w, n, E.view.query, qlen);
+    if (m)
+    {
+      off = from + (m - w);
+    }
+    editorViewRelease(from, from + n);
+    if (from + n == E.view.len)
+    {
+      break;
+    }
+    from += n - (qlen > n ? n : qlen - 1);
+  }
+  if (off == SIZE_MAX)
+  {
+    editorSetStatusMessage("Not found: %s", E.view.query);
+    return;
+  }
+
+  size_t start;
+  r = editorViewRowAt(off, &start);
+  editorViewFill(r);
+  E.cy = r - E.view.top;
+  E.cx = off - start;
+}
+
+void editorViewKey(int c)
+{
+  switch (c)
+  {
+  case 'q':
+  case CTRL_KEY('q'):
+    editorOutputWrite("\x1b[2J\x1b[H", 7);
+    exit(0);
+    break;
+
+  case ARROW_DOWN:
+  case 'j':
+    if (E.cy + 1 < E.numrows)
+    {
+      E.cy++;
+    }
+    else if (E.view.more)
+    {
+      editorViewFill(E.view.top + 1);
+    }
+    break;
+
+  case ARROW_UP:
+  case 'k':
+    if (E.cy > 0)
+    {
+      E.cy--;
+    }
+    else if (E.view.top > 0)
+    {
+      editorViewFill(E.view.top - 1);
+    }
+    break;
+
+  case PAGE_DOWN:
+  case ' ':
+    if (E.view.more)
+    {
+      editorViewFill(E.view.top + E.screenrows);
+    }
+    break;
+
+  case PAGE_UP:
+  case 'b':
+    editorViewFill(E.view.top > (size_t)E.screenrows ? E.view.top - E.screenrows : 0);
+    break;
+
+  case 'g':
+    E.cy = 0;
+    editorViewFill(0);
+    break;
+
+  case 'G':
+    editorViewScan(SIZE_MAX, SIZE_MAX);
+    editorViewFill(E.view.rows > (size_t)E.screenrows ? E.view.rows - E.screenrows : 0);
+    E.cy = E.numrows ? E.numrows - 1 : 0;
+    break;
+
+  case ARROW_LEFT:
+  case ARROW_RIGHT:
+  case HOME_KEY:
+  case END_KEY:
+    editorMoveCursor(c);
+    if (E.cy >= E.numrows)
+    {
+      E.cy = E.numrows ? E.numrows - 1 : 0; // stay inside the rows that are built
+      E.cx = 0;
+    }
+    break;
+
+  case '/':
+  case CTRL_KEY('f'):
+  {
+    char *query = editorPrompt("Search: %s (ESC to cancel)", NULL);
+    if (query)
+    {
+      free(E.view.query);
+      E.view.query = query;
+      editorViewSearch();
+    }
+  }
+  break;
+
+  case 'n':
+    editorViewSearch();
+    break;
+
+  case CTRL_KEY('l'):
+  case '\x1b':
+    break;
+
+  default:
+    editorSetStatusMessage("Read-only view: q quit, / search, n next, g/G top/bottom");
+    break;
+  }
+}
+
+// from editorIdle: carry on indexing so the line count and 'G' are ready
+void editorViewIdle()
+{
+  if (!E.view.active || E.view.eof)
+  {
+    return;
+  }
+  editorViewScan(SIZE_MAX, KILO_VIEW_SCAN_STEP);
+  editorRefreshScreen();
+}
+
+/*** FIND ***/
+
+/**
+ * Whether a frozen row, or one whose render was dropped, could match.
+ * Checked on its text so rows that don't are left as they are. Render
+ * is the text unless it has tabs or UTF-8, a row with either is
+ * rendered and searched the usual way.
+ */
+int editorFindMayMatch(erow *row, const char *query)
+{
+  const char *text = editorRowText(row);
+  if (memmem(text, row->size, query, strlen(query)))
+  {
+    return 1;
+  }
+  for (size_t j = 0; j < row->size; j++)
+  {
+    if (text[j] == '\t' || (text[j] & 0x80))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void editorFindCallback(char *query, int key)
+{
+
+  // declaring static vars as only 1 will appear in program
+  static int64_t last_match = -1;
+  static int direction = 1; // forward/back search
+
+  // static variables to keep state
+  static size_t saved_hl_line;  // reference to line changed
+  static size_t saved_hl_len;   // its rsize when it was saved
+  static char *saved_hl = NULL; // memory of line changed, NULL when nothing to restore
+
+  if (saved_hl)
+  {
+    // Restoring the line that was changed, unless it went away or was rewritten under us
+    if (saved_hl_line < E.numrows && editorRowDisplay(&E.row[saved_hl_line])->rsize == saved_hl_len)
+    {
+      editorRowOwnHl(&E.row[saved_hl_line]);
+      memcpy(E.display[saved_hl_line].hl, saved_hl, saved_hl_len);
+    }
+    editorFree(MEM_SEARCH, saved_hl);
+    saved_hl = NULL;
+  }
+
+  // return if the key pressed was ESC or RET
+  if (key == '\r' || key == '\x1b')
+  {
+    last_match = -1;
+    direction = 1;
+    return;
+  }
+  else if (key == ARROW_RIGHT || key == ARROW_DOWN)
+  {
+    direction = 1;
+  }
+  else if (key == ARROW_LEFT || key == ARROW_UP)
+  {
+    direction = -1;
+  }
+  else
+  {
+    // resetting search vars
+    last_match = -1;
+    direction = 1;
+  }
+
+  if (last_match == -1)
+  {
+    direction = 1;
+  }
+  int64_t current = last_match; // current is index of row we're currently searching
+
+  size_t i;
+
+  // loop through all rows in file, if row contain str it's a match
+  for (i = 0; i < E.numrows; i++)
+  {
+
+    current += direction;
+    if (current == -1)
+    {
+      // if there's no current, then current = last line
+      current = E.numrows - 1;
+    }
+    else if (current == (int64_t)E.numrows)
+    {
+      // if the search is in last row (status row) then current = 0
+      current = 0;
+    }
+
+    erow *row = &E.row[current];
+    if ((row->cold || ROW_DISPLAY(row)->render == NULL) && !editorFindMayMatch(row, query))
+    {
+      continue; // not worth decompressing or rendering it for good
+    }
+    rowDisplay *d = editorRowDisplay(row);
+    // compare strings
+    char *match = strstr(d->render, query);
+    if (match)
+    {
+      last_match = current;
+      E.cy = current;
+      E.cx = editorRowRxToCx(row, editorRowRbToRx(row, match - d->render));
+      E.rowoff = E.numrows;
+      // set to bottom of file
+      // so the next screen refresh will make search str found
+      // be placed at the top of the screen
+
+      saved_hl_line = current; // Line that was changed
+      saved_hl_len = d->rsize;
+      saved_hl = editorMalloc(MEM_SEARCH, d->rsize);
+      // copying line to allocated memory before highlighting was applied
+      // so we can restore it to default next time we enter this funtion
+      memcpy(saved_hl, d->hl, d->rsize);
+      // setting the highlighted region for the found strings in search code
+      editorRowOwnHl(row); // identical rows share hl, only this one is marked
+      memset(&d->hl[match - d->render], HL_MATCH, strlen(query));
+      break;
+    }
+  }
+}
+
+// search step with its latency recorded
+void editorFindTimed(char *query, int key)
+{
+  uint64_t start = editorNowNs();
+  editorTraceBegin("search", SIZE_MAX);
+  editorFindCallback(query, key);
+  editorTraceEnd("search");
+  editorStatsRecord(STAT_FIND, start);
+}
+
+// Ctrl-R: replace every match of a string in the whole buffer
+void editorReplace()
+{
+  char *query = editorPrompt("Replace: %s (ESC to cancel)", NULL);
+  if (query == NULL)
+  {
+    return;
+  }
+  char *with = editorPromptRead("With: %s (ESC to cancel)", NULL, 1); // empty deletes the matches
+  if (with == NULL)
+  {
+    free(query);
+    return;
+  }
+
+  editorTraceBegin("replace", SIZE_MAX);
+  size_t count = editorReplaceAll(query, strlen(query), with, strlen(with));
+  editorTraceEnd("replace");
+  editorReplaceStatus(count);
+
+  free(query);
+  free(with);
+}
+
+void editorFind()
+{
+
+  size_t saved_cx = E.cx;
+  size_t saved_cy = E.cy;
+  size_t saved_coloff = E.coloff;
+  size_t saved_rowoff = E.rowoff;
+
+  char *query = editorPrompt("Search: %s (ESC/Arrows/Enter)", editorFindTimed);
+
+  if (query)
+  {
+    free(query);
+  }
+  else
+  {
+    // resetting the cursor if cancelled search
+    E.cx = saved_cx;
+    E.cy = saved_cy;
+    E.coloff = saved_coloff;
+    E.rowoff = saved_rowoff;
+  }
+}
+
+/*** append buffer ***/
+// Instead of doing x small writes, we are making buffer to do 1 big write
+
+// creating our own dynamic string type
+struct abuf
+{
+  char *b;
+  size_t len;
+};
+
+// acts as constructor for the abuf type
+#define ABUF_INIT \
+  {               \
+    NULL, 0       \
+  }
+
+void abAppend(struct abuf *ab, const char *s, size_t len)
+{
+  // realloc comes from <stdlib.h>
+  // makes sure we have enough memory to hold new string
+  char *new = editorRealloc(MEM_OUTPUT, ab->b, ab->len + len);
+  // gives us memory = cur_mem_size + new_thing_to_append
+
+  // return if the size is null
+  if (new == NULL)
+  {
+    return;
+  }
+
+  // memcpy comes from <string.h>
+  // copy string s after the end of current data
+  memcpy(&new[ab->len], s, len);
+  ab->b = new;
+  ab->len += len;
+}
+
+// deconstructor that deallocates dynamic memory used by an abuf
+void abFree(struct abuf *ab)
+{
+  // comes from <stdlib.h>
+  editorFree(MEM_OUTPUT, ab->b);
+}
+
+/*** soft wrap ***/
+
+// screen lines a row takes when wrapped, an empty row still takes one
+size_t editorWrapCount(erow *row)
+{
+  size_t cols = E.screencols;
+  return row->rwidth == 0 ? 1 : (row->rwidth + cols - 1) / cols;
+}
+
+void editorWrapInvalidate()
+{
+  E.wrap.stale = 1;
+}
+
+// add 'delta' to row i's count (unsigned wraparound makes negative deltas work)
+void editorWrapAdd(size_t i, size_t delta)
+{
+  for (i++; i <= E.wrap.n; i += i & -i)
+  {
+    E.wrap.tree[i] += delta;
+  }
+}
+
+// screen lines taken by the first 'rows' rows
+size_t editorWrapPrefix(size_t rows)
+{
+  size_t sum = 0;
+  for (size_t i = rows; i > 0; i -= i & -i)
+  {
+    sum += E.wrap.tree[i];
+  }
+  return sum;
+}
+
+// the row shown on screen line 'line', and which of its wrapped lines it is
+size_t editorWrapFind(size_t line, size_t *seg)
+{
+  size_t pos = 0;
+  size_t step = 1;
+  while (step * 2 <= E.wrap.n)
+  {
+    step *= 2;
+  }
+  for (; step > 0; step /= 2)
+  {
+    if (pos + step <= E.wrap.n && E.wrap.tree[pos + step] <= line)
+    {
+      pos += step;
+      line -= E.wrap.tree[pos];
+    }
+  }
+  *seg = line;
+  return pos;
+}
+
+/**
+ * Rows [at, at + del) were replaced by [at, at + ins). Their counts are
+ * spliced into 'lines' and only the tree nodes past 'at' are rebuilt:
+ * the ones up to it cover earlier rows, which didn't change. Inserted
+ * rows count as one line until editorUpdateRow renders them.
+ */
+void editorWrapSplice(size_t at, size_t del, size_t ins)
+{
+  if (!E.wrap.enabled || E.wrap.stale || E.wrap.cols != (size_t)E.screencols ||
+      at > E.wrap.n || del > E.wrap.n - at || E.wrap.n - del + ins != E.numrows)
+  {
+    E.wrap.stale = 1; // rebuilt in full when it's next needed
+    return;
+  }
+
+  size_t n = E.numrows;
+  if (ins > del)
+  {
+    E.wrap.lines = editorRealloc(MEM_WRAP, E.wrap.lines, sizeof(size_t) * (n + 1));
+    E.wrap.tree = editorRealloc(MEM_WRAP, E.wrap.tree, sizeof(size_t) * (n + 1));
+  }
+  memmove(&E.wrap.lines[at + ins], &E.wrap.lines[at + del], sizeof(size_t) * (E.wrap.n - at - del));
+  for (size_t i = 0; i < ins; i++)
+  {
+    E.wrap.lines[at + i] = editorWrapCount(&E.row[at + i]);
+  }
+  E.wrap.n = n;
+
+  for (size_t i = at + 1; i <= n; i++)
+  {
+    E.wrap.tree[i] = E.wrap.lines[i - 1];
+  }
+  // nodes up to 'at' whose parent is past it: the ones a prefix sum of 'at' visits
+  for (size_t i = at; i > 0; i -= i & -i)
+  {
+    size_t parent = i + (i & -i);
+    if (parent <= n)
+    {
+      E.wrap.tree[parent] += E.wrap.tree[i];
+    }
+  }
+  for (size_t i = at + 1; i <= n; i++)
+  {
+    size_t parent = i + (i & -i);
+    if (parent <= n)
+    {
+      E.wrap.tree[parent] += E.wrap.tree[i];
+    }
+  }
+}
+
+// O(n) rebuild - only after the screen was resized or wrapping turned on
+void editorWrapEnsure()
+{
+  if (!E.wrap.stale && E.wrap.n == E.numrows && E.wrap.cols == (size_t)E.screencols)
+  {
+    return;
+  }
+
+  size_t n = E.numrows;
+  E.wrap.lines = editorRealloc(MEM_WRAP, E.wrap.lines, sizeof(size_t) * (n + 1));
+  E.wrap.tree = editorRealloc(MEM_WRAP, E.wrap.tree, sizeof(size_t) * (n + 1));
+  E.wrap.n = n;
+  E.wrap.cols = E.screencols;
+
+  E.wrap.tree[0] = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    E.wrap.lines[i] = editorWrapCount(&E.row[i]);
+    E.wrap.tree[i + 1] = E.wrap.lines[i];
+  }
+  // build the tree in place, each node passes its sum on to its parent
+  for (size_t i = 1; i <= n; i++)
+  {
+    size_t parent = i + (i & -i);
+    if (parent <= n)
+    {
+      E.wrap.tree[parent] += E.wrap.tree[i];
+    }
+  }
+  E.wrap.stale = 0;
+}
+
+// called from editorUpdateRow, keeps the cache current for in-row edits
+void editorWrapRowChanged(erow *row)
+{
+  if (!E.wrap.enabled || E.wrap.stale || ROW_IDX(row) >= E.wrap.n ||
+      E.wrap.cols != (size_t)E.screencols)
+  {
+    return;
+  }
+  size_t lines = editorWrapCount(row);
+  if (lines != E.wrap.lines[ROW_IDX(row)])
+  {
+    editorWrapAdd(ROW_IDX(row), lines - E.wrap.lines[ROW_IDX(row)]);
+    E.wrap.lines[ROW_IDX(row)] = lines;
+  }
+}
+
+// screen line the cursor is on, and its column within that line
+size_t editorWrapCursorLine(size_t *x)
+{
+  size_t cols = E.screencols;
+  if (E.cy >= E.numrows)
+  {
+    *x = 0;
+    return editorWrapPrefix(E.numrows);
+  }
+  size_t seg = E.rx / cols;
+  if (seg >= E.wrap.lines[E.cy])
+  {
+    seg = E.wrap.lines[E.cy] - 1; // cursor just past a row that fills its last line
+  }
+  *x = E.rx - seg * cols;
+  return editorWrapPrefix(E.cy) + seg;
+}
+
+// put the cursor at the start of screen line 'line'
+void editorWrapGotoLine(size_t line)
+{
+  size_t seg;
+  E.cy = editorWrapFind(line, &seg);
+  E.cx = 0;
+  if (E.cy < E.numrows)
+  {
+    E.cx = editorRowRxToCx(&E.row[E.cy], seg * E.screencols);
+  }
+  else
+  {
+    E.cy = E.numrows;
+  }
+}
+
+/**
+ * Arrow up / down move by screen line when wrapping,
+ * returns 0 if the normal row movement should be used
+ */
+int editorWrapMoveVertical(int dir)
+{
+  if (!E.wrap.enabled || E.cy >= E.numrows)
+  {
+    return 0;
+  }
+  editorWrapEnsure();
+
+  size_t cols = E.screencols;
+  erow *row = &E.row[E.cy];
+  size_t rx = editorRowCxToRx(row, E.cx);
+  size_t seg = rx / cols;
+  if (seg >= E.wrap.lines[E.cy])
+  {
+    seg = E.wrap.lines[E.cy] - 1;
+  }
+  size_t x = rx - seg * cols;
+
+  if (dir < 0)
+  {
+    if (seg > 0)
+    {
+      E.cx = editorRowRxToCx(row, rx - cols);
+    }
+    else if (E.cy > 0)
+    {
+      E.cy--;
+      E.cx = editorRowRxToCx(&E.row[E.cy], (E.wrap.lines[E.cy] - 1) * cols + x);
+    }
+  }
+  else
+  {
+    if (seg + 1 < E.wrap.lines[E.cy])
+    {
+      E.cx = editorRowRxToCx(row, rx + cols);
+    }
+    else
+    {
+      E.cy++;
+      E.cx = (E.cy < E.numrows) ? editorRowRxToCx(&E.row[E.cy], x) : 0;
+    }
+  }
+  return 1;
+}
+
+void editorToggleWrap()
+{
+  E.wrap.enabled = !E.wrap.enabled;
+  E.wrap.stale = 1;
+  E.wrap.top = 0;
+  E.coloff = 0;
+  editorSetStatusMessage("Soft wrap %s", E.wrap.enabled ? "on" : "off");
+}
+
+void editorHandleWinch(int sig)
+{
+  (void)sig;
+  winch = 1;
+}
+
+// pick up a new terminal size after SIGWINCH
+void editorUpdateWindowSize()
+{
+  winch = 0;
+  if (getWindowSize(&E.screenrows, &E.screencols) == -1)
+  {
+    die("getWindowSize");
+  }
+  E.screenrows -= 2; // status bar and message bar
+  editorWrapInvalidate();
+  if (E.view.active)
+  {
+    editorViewFill(E.view.top); // the screen's rows are all that's built
+  }
+}
+
+/*** output ***/
+void editorScroll()
+{
+  E.rx = 0; // change cursor to be render item not chars
+  if (E.cy < E.numrows)
+  {
+    E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+  }
+
+  if (E.wrap.enabled)
+  {
+    // scroll by screen lines, rows are never cut off horizontally
+    editorWrapEnsure();
+    size_t x;
+    size_t line = editorWrapCursorLine(&x);
+    if (line < E.wrap.top)
+    {
+      E.wrap.top = line;
+    }
+    if (line >= E.wrap.top + (size_t)E.screenrows)
+    {
+      E.wrap.top = line - E.screenrows + 1;
+    }
+    size_t seg;
+    E.rowoff = editorWrapFind(E.wrap.top, &seg);
+    E.coloff = 0;
+    return;
+  }
+
+  // check if cursor moved outside of visible window
+  // adjust E.rowoff so cursor is just inside visible window
+  if (E.cy < E.rowoff)
+  {
+    E.rowoff = E.cy;
+  }
+  if (E.cy >= E.rowoff + (size_t)E.screenrows)
+  {
+    E.rowoff = E.cy - E.screenrows + 1;
+  }
+
+  if (E.rx < E.coloff)
+  {
+    E.coloff = E.rx;
+  }
+  if (E.rx >= E.coloff + (size_t)E.screencols)
+  {
+    E.coloff = E.rx - E.screencols + 1;
+  }
+}
+
+/**
+ * Draw 'cols' screen columns of a row starting at column 'coloff'.
+ * ASCII rows map columns straight onto render bytes, UTF-8 rows use
+ * the widths cached in the row checkpoints.
+ */
+void editorDrawRow(struct abuf *ab, erow *row, size_t coloff, size_t cols)
+{
+  rowDisplay *d = editorRowDisplay(row);
+  size_t j = coloff;   // render byte we're drawing
+  size_t col = coloff; // screen column of render[j]
+  size_t k = 0;        // next checkpoint in the row
+  size_t end = coloff + cols;
+
+  if (!d->ascii)
+  {
+    ssize_t cpk = editorRowFindCheckpoint(row, offsetof(rowCheckpoint, rx), coloff);
+    if (cpk == -1)
+    {
+      k = 0;
+    }
+    else if (coloff < d->cp[cpk].rxe)
+    {
+      rowCheckpoint *cp = &d->cp[cpk];
+      if (cp->rbe - cp->rb == cp->rxe - cp->rx)
+      {
+        j = cp->rb + (coloff - cp->rx); // part way through a tab's spaces
+      }
+      else
+      {
+        // left half of a wide char is scrolled off, pad the right half
+        for (; col < cp->rxe && col < end; col++)
+        {
+          abAppend(ab, " ", 1);
+        }
+        j = cp->rbe;
+      }
+      k = cpk + 1;
+    }
+    else
+    {
+      j = d->cp[cpk].rbe + (coloff - d->cp[cpk].rxe);
+      k = cpk + 1;
+    }
+  }
+
+  char *c = d->render;
+  // getting current char in highlighting array
+  unsigned char *hl = d->hl;
+  int current_color = -1;
+  // render bytes inside the selection are drawn inverted
+  size_t sel0 = 0, sel1 = 0;
+  int selected = 0;
+  editorSelectionRowRange(row, &sel0, &sel1);
+  while (j < d->rsize && col < end)
+  {
+    size_t n = 1; // bytes in this char
+    size_t w = 1; // columns it takes
+    if (!d->ascii && k < d->ncp && d->cp[k].rb == j)
+    {
+      n = d->cp[k].rbe - d->cp[k].rb;
+      w = d->cp[k].rxe - d->cp[k].rx;
+      k++;
+      if (col + w > end)
+      {
+        break; // a wide char that doesn't fit on the screen
+      }
+    }
+
+    if ((j >= sel0 && j < sel1) != selected)
+    {
+      selected = !selected;
+      abAppend(ab, selected ? "\x1b[7m" : "\x1b[27m", selected ? 4 : 5);
+    }
+
+    unsigned char uc = c[j];
+    if (n == 1 && uc < 0x80 && iscntrl(uc))
+    {
+      // Symbol is @ char or ? if it's not in alphabet
+      char sym = (uc <= 26) ? '@' + uc : '?';
+      // Highlight differently
+      abAppend(ab, "\x1b[7m", 4);
+      abAppend(ab, &sym, 1);
+      // change back to normal when finished;
+      abAppend(ab, "\x1b[m", 3);
+      if (current_color != -1)
+      {
+        // change back to whatever the normal colour was if we are finished
+        char buf[16];
+        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
+        abAppend(ab, buf, clen);
+      }
+      if (selected)
+      {
+        abAppend(ab, "\x1b[7m", 4);
+      }
+    }
+    else if (hl[j] == HL_NORMAL)
+    {
+      // Making it a little more efficient
+      if (current_color != -1)
+      {
+        // default colour on normal highlighting
+        abAppend(ab, "\x1b[39m", 5);
+        current_color = -1;
+      }
+      abAppend(ab, &c[j], n);
+    }
+    else
+    {
+      // red colour for digits
+      int color = editorSyntaxToColor(hl[j]);
+      if (color != current_color)
+      {
+        current_color = color;
+        char buf[16];
+        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
+        abAppend(ab, buf, clen);
+      }
+      abAppend(ab, &c[j], n);
+    }
+    j += n;
+    col += w;
+  }
+  if (selected)
+  {
+    abAppend(ab, "\x1b[27m", 5);
+  }
+  // ensuring we reset to default after row is checked
+  abAppend(ab, "\x1b[39m", 5);
+}
+
+void editorDrawRows(struct abuf *ab)
+{
+  int y;
+  size_t filerow = E.rowoff;
+  size_t seg = 0; // wrapped line of filerow being drawn
+  if (E.wrap.enabled)
+  {
+    filerow = editorWrapFind(E.wrap.top, &seg);
+  }
+  for (y = 0; y < E.screenrows; y++)
+  {
+    if (!E.wrap.enabled)
+    {
+      filerow = y + E.rowoff; // displaying correct line of the file if reading from file
+    }
+
+    // check if the row we're drawing is part of text buffer or row that comes before / after
+    if (filerow >= E.numrows)
+    {
+
+      // don't write the welcome message if we have read in a file
+      if (E.numrows == 0 && y == E.screenrows / 3)
+      {
+        char welcome[80];
+        // snprinft - comes from <stdio.h>
+        // interpolate KILO_VERSION string into welcome msg
+        int welcomelen = snprintf(welcome, sizeof(welcome),
+                                  "Kilo editor -- version %s", KILO_VERSION);
+
+        // truncate string length if terminal is too small
+        if (welcomelen > E.screencols)
+        {
+          welcomelen = E.screencols;
+        }
+
+        // creating padding around the welcome string in the terminal
+        int padding = (E.screencols - welcomelen) / 2;
+
+        if (padding)
+        {
+          abAppend(ab, "~", 1);
+          padding--;
+        }
+        while (padding--)
+        {
+          abAppend(ab, " ", 1);
+        }
+        abAppend(ab, welcome, welcomelen);
+      }
+      else
+      {
+        // making sure we write ~ on every row
+        // write(STDOUT_FILENO, "~", 1);
+        abAppend(ab, "~", 1);
+      }
+    }
+    else if (E.wrap.enabled)
+    {
+      // next screen width slice of the row, then on to the next row
+      editorDrawRow(ab, &E.row[filerow], seg * E.screencols, E.screencols);
+      if (++seg >= E.wrap.lines[filerow])
+      {
+        filerow++;
+        seg = 0;
+      }
+    }
+    else
+    {
+      editorDrawRow(ab, &E.row[filerow], E.coloff, E.screencols);
+    }
+
+    abAppend(ab, "\x1b[K", 3); // clear the line
+
+    abAppend(ab, "\r\n", 2);
+  }
+}
+
+void editorDrawStatusBar(struct abuf *ab)
+{
+  // explaining m commands - https://vt100.net/docs/vt100-ug/chapter3.html#SGR
+  abAppend(ab, "\x1b[7m", 4); // escape sequence - switches to inverted colours
+  char status[80], rstatus[80];
+
+  // getting length of row to write
+  // Copying filename / [no name] to buffer
+  int len;
+  if (E.view.active)
+  {
+    // '+' while the file is still being indexed
+    len = snprintf(status, sizeof(status), "%.20s - %zu%s lines (view)",
+                   E.filename, E.view.rows, E.view.eof ? "" : "+");
+  }
+  else
+  {
+    len = snprintf(status, sizeof(status), "%.20s - %zu lines %s",
+                   E.filename ? E.filename : "[No Name]", E.numrows, E.dirty ? "(modified)" : (E.follow.fd != -1 ? "(following)" : ""));
+  }
+
+  // Render line also includes the current line number at right edge of screen
+  int rlen;
+  if (E.stats.overlay)
+  {
+    // latency overlay instead, the file name gives way to make room for it
+    rlen = editorStatsOverlay(rstatus, sizeof(rstatus));
+    if (rlen > E.screencols)
+    {
+      rlen = E.screencols;
+    }
+    if (len > E.screencols - rlen)
+    {
+      len = E.screencols - rlen;
+    }
+  }
+  else
+  {
+    size_t y = E.view.active ? E.view.top + E.cy : E.cy;
+    size_t rows = E.view.active ? E.view.rows : E.numrows;
+    rlen = snprintf(rstatus, sizeof(rstatus), "%s | %zu/%zu", E.syntax ? E.syntax->filetype : "no ft", y + 1, rows);
+  }
+
+  // Cut string short if it's too big..
+  if (len > E.screencols)
+  {
+    len = E.screencols;
+  }
+  // write to the screen
+  abAppend(ab, status, len);
+
+  while (len < E.screencols)
+  {
+    if (E.screencols - len == rlen)
+    {
+      abAppend(ab, rstatus, rlen);
+      break;
+    }
+    else
+    {
+      abAppend(ab, " ", 1);
+      len++;
+    }
+  }
+
+  abAppend(ab, "\x1b[m", 3); // escape sequence - switches back to normal colours
+  abAppend(ab, "\r\n", 2);   // making room for status bar
+}
+
+void editorDrawMessageBar(struct abuf *ab)
+{
+  abAppend(ab, "\x1b[K", 3);
+
+  int msglen = strlen(E.statusmsg); // getting length of status msg string
+
+  // Ensuring we don't go over assigned width
+  if (msglen > E.screencols)
+  {
+    msglen = E.screencols;
+  }
+  // if there's a status msg and passed time is < 5 seconds
+  // draw the new status message to the screen
+  if (msglen && time(NULL) - E.statusmsg_time < 5)
+  {
+    abAppend(ab, E.statusmsg, msglen);
+  }
+}
+
+// Clears the terminal
+// the extra cursors, drawn as inverted cells over the text
+void editorDrawCursors(struct abuf *ab)
+{
+  size_t cy = E.cy, rx = E.rx;
+  for (size_t i = 0; i < E.ncursors; i++)
+  {
+    editorCursor *c = &E.cursors[i];
+    erow *row = c->cy < E.numrows ? &E.row[c->cy] : NULL;
+    size_t crx = row ? editorRowCxToRx(row, c->cx) : 0;
+    size_t y, x;
+    if (E.wrap.enabled)
+    {
+      // borrow the primary cursor's slot to ask the wrap layout
+      E.cy = c->cy;
+      E.rx = crx;
+      y = editorWrapCursorLine(&x);
+      E.cy = cy;
+      E.rx = rx;
+      if (y < E.wrap.top || y - E.wrap.top >= (size_t)E.screenrows)
+      {
+        continue;
+      }
+      y -= E.wrap.top;
+    }
+    else
+    {
+      if (c->cy < E.rowoff || c->cy - E.rowoff >= (size_t)E.screenrows ||
+          crx < E.coloff || crx - E.coloff >= (size_t)E.screencols)
+      {
+        continue;
+      }
+      y = c->cy - E.rowoff;
+      x = crx - E.coloff;
+    }
+
+    // the char under it if it's a plain one column char, otherwise a blank
+    const char *ch = " ";
+    size_t len = 1;
+    if (row && c->cx < row->size && row->chars[c->cx] != '\t' &&
+        !iscntrl((unsigned char)row->chars[c->cx]))
+    {
+      uint32_t cp;
+      size_t n = editorUtf8Decode(&row->chars[c->cx], row->size - c->cx, &cp);
+      if (n && editorCharWidth(cp) == 1)
+      {
+        ch = &row->chars[c->cx];
+        len = n;
+      }
+    }
+
+    char buf[32];
+    int blen = snprintf(buf, sizeof(buf), "\x1b[%zu;%zuH\x1b[7m", y + 1, x + 1);
+    abAppend(ab, buf, blen);
+    abAppend(ab, ch, len);
+    abAppend(ab, "\x1b[m", 3);
+  }
+}
+
+void editorRefreshScreen()
+{
+  uint64_t start = editorNowNs();
+  editorTraceBegin("draw", SIZE_MAX);
+  if (winch)
+  {
+    editorUpdateWindowSize();
+  }
+  editorScroll();
+
+  // init the new dynamic memo string buffer
+  struct abuf ab = ABUF_INIT;
+
+  // removing the cursor flicker
+  abAppend(&ab, "\x1b[?25l", 6); // l = set mode
+
+  // 4 = write 4 bytes
+  // \x1b[2j] -> ESCAPE SEQUENCE
+
+  // \x1b -> escape character
+  // [ -> always follows the escape character
+
+  // J -> clear the screen
+  // 2 -> clear the entire screen
+  // <esc>[1J would clear screen up to where cursor is
+  // write(STDOUT_FILENO, "\x1b[2J", 4);
+  // abAppend(&ab, "\x1b[2J", 4); -> replaced clear screen with clear line in editorDrawRows
+
+  // Reposition cursor to top left corner after refresh
+  // write(STDOUT_FILENO, "\x1b[H", 3);
+  abAppend(&ab, "\x1b[H", 3);
+
+  // draw the ~ symbol at beggining of row
+  editorDrawRows(&ab);
+  editorDrawStatusBar(&ab);
+  editorDrawMessageBar(&ab);
+  editorDrawCursors(&ab);
+
+  // specifying exact position for the cursor to move to
+  //
+  char buf[32];
+  if (E.wrap.enabled)
+  {
+    size_t x;
+    size_t line = editorWrapCursorLine(&x);
+    snprintf(buf, sizeof(buf), "\x1b[%zu;%zuH", (line - E.wrap.top) + 1, x + 1);
+  }
+  else
+  {
+    snprintf(buf, sizeof(buf), "\x1b[%zu;%zuH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1);
+  }
+  abAppend(&ab, buf, strlen(buf));
+
+  // returning cursor flicker
+  abAppend(&ab, "\x1b[?25h", 6); // h = reset mode
+
+  // write the buffer to the screen
+  editorOutputWrite(ab.b, ab.len);
+
+  // free the buffer after the write
+  abFree(&ab);
+
+  editorTraceEnd("draw");
+  editorStatsRecord(STAT_DRAW, start);
+  if (E.stats.key_ns)
+  {
+    editorStatsRecord(STAT_KEY, E.stats.key_ns);
+    E.stats.key_ns = 0;
+  }
+}
+
+/*
+ * the ... makes this function a variadic function,
+ * meaning it can take any number of arguments.
+ */
+void editorSetStatusMessage(const char *fmt, ...)
+{
+  /*
+   * Calls va_Start and va_end on a value of type va_list
+   * last arg before ... must be passed to va_start.
+   * Between start and end, you would call va_arg and pass it type of next arg
+   *
+   */
+
+  // va_list | va_start | va_end come from stdarg.
+  va_list ap;
+  va_start(ap, fmt);
+  // vsnprintf comes from stdio.h
+  // makes out own printf funct. Store result in E.statusmgr
+  vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
+  va_end(ap);
+  E.statusmsg_time = time(NULL); // getting current time
+}
+
+/*** virtual terminal ***/
+
+/**
+ * In-memory terminal for measuring what we draw without a real
+ * emulator in the way. It understands the escape sequences the editor
+ * emits (cursor moves, erase, SGR colours, cursor show / hide) and
+ * keeps a grid of cells plus counts of what it was sent.
+ */
+struct vterm
+{
+  int rows;
+  int cols;
+  uint32_t *cells;       // code point per cell, 0 is the right half of a wide char
+  unsigned short *attr;  // SGR state each cell was drawn with
+  int cy, cx;
+  unsigned short cur;    // current SGR state: fg colour code, 0x100 for inverse
+  int cursor_visible;
+  char seq[32];          // escape sequence being parsed, may span writes
+  size_t seqlen;
+  char utf[4];           // UTF-8 char being collected
+  size_t utflen;
+  size_t frames;         // writes received
+  size_t bytes;
+  size_t escapes;
+};
+
+void vtermInit(struct vterm *vt, int rows, int cols)
+{
+  memset(vt, 0, sizeof(*vt));
+  vt->rows = rows;
+  vt->cols = cols;
+  vt->cells = malloc(sizeof(uint32_t) * rows * cols);
+  vt->attr = malloc(sizeof(unsigned short) * rows * cols);
+  for (int i = 0; i < rows * cols; i++)
+  {
+    vt->cells[i] = ' ';
+    vt->attr[i] = 0;
+  }
+  vt->cursor_visible = 1;
+}
+
+void vtermFree(struct vterm *vt)
+{
+  free(vt->cells);
+  free(vt->attr);
+}
+
+void vtermClear(struct vterm *vt, int from, int to)
+{
+  for (int i = from; i < to; i++)
+  {
+    vt->cells[i] = ' ';
+    vt->attr[i] = vt->cur;
+  }
+}
+
+void vtermPut(struct vterm *vt, uint32_t cp)
+{
+  int width = editorCharWidth(cp);
+  if (width == 0)
+  {
+    return; // combining mark, stays with the char before it
+  }
+
+  // wrap is deferred until a char actually goes past the edge
+  if (vt->cx + width > vt->cols)
+  {
+    vt->cx = 0;
+    vt->cy++;
+  }
+  if (vt->cy >= vt->rows)
+  {
+    // scroll everything up a line
+    memmove(vt->cells, vt->cells + vt->cols, sizeof(uint32_t) * (vt->rows - 1) * vt->cols);
+    memmove(vt->attr, vt->attr + vt->cols, sizeof(unsigned short) * (vt->rows - 1) * vt->cols);
+    vtermClear(vt, (vt->rows - 1) * vt->cols, vt->rows * vt->cols);
+    vt->cy = vt->rows - 1;
+  }
+
+  int at = vt->cy * vt->cols + vt->cx;
+  vt->cells[at] = cp;
+  vt->attr[at] = vt->cur;
+  if (width == 2)
+  {
+    vt->cells[at + 1] = 0;
+    vt->attr[at + 1] = vt->cur;
+  }
+  vt->cx += width;
+}
+
+// a complete CSI sequence is in vt->seq
+void vtermEscape(struct vterm *vt)
+{
+  char final = vt->seq[vt->seqlen - 1];
+  int priv = vt->seq[2] == '?';
+  int params[8];
+  int nparams = 0;
+  int val = -1;
+
+  for (size_t i = priv ? 3 : 2; i < vt->seqlen; i++)
+  {
+    char c = vt->seq[i];
+    if (isdigit((unsigned char)c))
+    {
+      val = (val < 0 ? 0 : val * 10) + (c - '0');
+    }
+    else if (nparams < 8)
+    {
+      params[nparams++] = val; // -1 when the parameter was left out
+      val = -1;
+    }
+  }
+
+  int p0 = params[0] < 0 ? 0 : params[0];
+  int n = p0 ? p0 : 1;
+  switch (final)
+  {
+  case 'H':
+    vt->cy = (p0 ? p0 : 1) - 1;
+    vt->cx = (nparams > 1 && params[1] > 0 ? params[1] : 1) - 1;
+    break;
+  case 'A':
+    vt->cy -= n;
+    break;
+  case 'B':
+    vt->cy += n;
+    break;
+  case 'C':
+    vt->cx += n;
+    break;
+  case 'D':
+    vt->cx -= n;
+    break;
+  case 'K':
+    if (p0 == 0 && vt->cy < vt->rows)
+    {
+      vtermClear(vt, vt->cy * vt->cols + vt->cx, (vt->cy + 1) * vt->cols);
+    }
+    break;
+  case 'J':
+    if (p0 == 2)
+    {
+      vtermClear(vt, 0, vt->rows * vt->cols);
+    }
+    break;
+  case 'm':
+    for (int i = 0; i < nparams; i++)
+    {
+      int v = params[i] < 0 ? 0 : params[i];
+      if (v == 0)
+      {
+        vt->cur = 0;
+      }
+      else if (v == 7)
+      {
+        vt->cur |= 0x100;
+      }
+      else if (v == 27)
+      {
+        vt->cur &= ~0x100;
+      }
+      else if ((v >= 30 && v <= 39) || (v >= 90 && v <= 97))
+      {
+        vt->cur = (vt->cur & 0x100) | (v == 39 ? 0 : v);
+      }
+    }
+    break;
+  case 'h':
+  case 'l':
+    if (priv && p0 == 25)
+    {
+      vt->cursor_visible = final == 'h';
+    }
+    break;
+  }
+
+  // keep the cursor on the screen like a real terminal does
+  vt->cy = vt->cy < 0 ? 0 : vt->cy >= vt->rows ? vt->rows - 1 : vt->cy;
+  vt->cx = vt->cx < 0 ? 0 : vt->cx >= vt->cols ? vt->cols - 1 : vt->cx;
+}
+
+// editorOutput sink, ctx is the struct vterm
+void vtermWrite(void *ctx, const char *buf, size_t len)
+{
+  struct vterm *vt = ctx;
+  vt->frames++;
+  vt->bytes += len;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    char c = buf[i];
+
+    if (vt->seqlen)
+    {
+      if (vt->seqlen < sizeof(vt->seq))
+      {
+        vt->seq[vt->seqlen++] = c;
+      }
+      if (vt->seqlen == 2 && c != '[')
+      {
+        vt->seqlen = 0; // not a CSI, nothing we emit
+      }
+      else if (vt->seqlen > 2 && c >= 0x40 && c <= 0x7e)
+      {
+        vtermEscape(vt);
+        vt->seqlen = 0;
+      }
+      continue;
+    }
+
+    if (c == '\x1b')
+    {
+      vt->seq[0] = c;
+      vt->seqlen = 1;
+      vt->escapes++;
+    }
+    else if (c == '\r')
+    {
+      vt->cx = 0;
+    }
+    else if (c == '\n')
+    {
+      if (vt->cy < vt->rows - 1)
+      {
+        vt->cy++;
+      }
+    }
+    else if ((unsigned char)c >= 0x20)
+    {
+      // collect a whole UTF-8 char before placing it
+      vt->utf[vt->utflen++] = c;
+      uint32_t cp;
+      if (editorUtf8Decode(vt->utf, vt->utflen, &cp))
+      {
+        vtermPut(vt, cp);
+        vt->utflen = 0;
+      }
+      else if (vt->utflen == sizeof(vt->utf) || ((unsigned char)vt->utf[0] < 0xC2 || (unsigned char)vt->utf[0] > 0xF4))
+      {
+        vtermPut(vt, '?'); // not UTF-8 at all
+        vt->utflen = 0;
+      }
+    }
+  }
+}
+
+// one screen line as UTF-8, trailing blanks trimmed
+void vtermLine(struct vterm *vt, int y, struct abuf *ab)
+{
+  int end = vt->cols;
+  while (end > 0 && vt->cells[y * vt->cols + end - 1] == ' ')
+  {
+    end--;
+  }
+  for (int x = 0; x < end; x++)
+  {
+    uint32_t cp = vt->cells[y * vt->cols + x];
+    char buf[4];
+    size_t n;
+    if (cp == 0)
+    {
+      continue; // right half of a wide char
+    }
+    else if (cp < 0x80)
+    {
+      buf[0] = cp;
+      n = 1;
+    }
+    else if (cp < 0x800)
+    {
+      buf[0] = 0xC0 | (cp >> 6);
+      buf[1] = 0x80 | (cp & 0x3F);
+      n = 2;
+    }
+    else if (cp < 0x10000)
+    {
+      buf[0] = 0xE0 | (cp >> 12);
+      buf[1] = 0x80 | ((cp >> 6) & 0x3F);
+      buf[2] = 0x80 | (cp & 0x3F);
+      n = 3;
+    }
+    else
+    {
+      buf[0] = 0xF0 | (cp >> 18);
+      buf[1] = 0x80 | ((cp >> 12) & 0x3F);
+      buf[2] = 0x80 | ((cp >> 6) & 0x3F);
+      buf[3] = 0x80 | (cp & 0x3F);
+      n = 4;
+    }
+    abAppend(ab, buf, n);
+  }
+}
+
+/*** multiple cursors ***/
+
+/**
+ * Ctrl-N adds a cursor on the line below the last one. Typing, deleting
+ * and moving then happen at every cursor: each row is rebuilt once for
+ * all the cursors on it, re-rendered once, and the whole keypress is
+ * recorded compactly (an insert at n cursors is one OP_REPLACE of the
+ * empty string). Any other editing key drops back to a single cursor.
+ */
+
+int editorCursorCmp(const void *a, const void *b)
+{
+  const editorCursor *x = a;
+  const editorCursor *y = b;
+  if (x->cy != y->cy)
+  {
+    return x->cy < y->cy ? -1 : 1;
+  }
+  return (x->cx > y->cx) - (x->cx < y->cx);
+}
+
+// every cursor, primary included, sorted by position
+editorCursor *editorCursorsGather(size_t *n)
+{
+  editorCursor *all = malloc(sizeof(editorCursor) * (E.ncursors + 1));
+  memcpy(all, E.cursors, sizeof(editorCursor) * E.ncursors);
+  all[E.ncursors].cy = E.cy;
+  all[E.ncursors].cx = E.cx;
+  all[E.ncursors].primary = 1;
+  *n = E.ncursors + 1;
+  qsort(all, *n, sizeof(editorCursor), editorCursorCmp);
+  return all;
+}
+
+// put them back, cursors that have ended up in the same spot merge
+void editorCursorsScatter(editorCursor *all, size_t n)
+{
+  qsort(all, n, sizeof(editorCursor), editorCursorCmp);
+  E.cursors = realloc(E.cursors, sizeof(editorCursor) * n);
+  E.ncursors = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    int dup = i + 1 < n && all[i + 1].cy == all[i].cy && all[i + 1].cx == all[i].cx;
+    if (dup)
+    {
+      all[i + 1].primary |= all[i].primary;
+      continue;
+    }
+    if (all[i].primary)
+    {
+      E.cy = all[i].cy;
+      E.cx = all[i].cx;
+    }
+    else
+    {
+      E.cursors[E.ncursors++] = all[i];
+    }
+  }
+  free(all);
+}
+
+void editorCursorsClear()
+{
+  free(E.cursors);
+  E.cursors = NULL;
+  E.ncursors = 0;
+}
+
+// Ctrl-N: new cursor one line below the lowest, at the primary's column
+void editorCursorAdd()
+{
+  size_t n;
+  editorCursor *all = editorCursorsGather(&n);
+  size_t cy = all[n - 1].cy + 1;
+  if (cy >= E.numrows)
+  {
+    free(all);
+    editorSetStatusMessage("No line below for another cursor");
+    return;
+  }
+
+  erow *row = &E.row[cy];
+  editorRowWarm(row);
+  size_t cx = E.cx < row->size ? E.cx : row->size;
+  while (cx > 0 && cx < row->size && ((unsigned char)row->chars[cx] & 0xC0) == 0x80)
+  {
+    cx--;
+  }
+  all = realloc(all, sizeof(editorCursor) * (n + 1));
+  all[n].cy = cy;
+  all[n].cx = cx;
+  all[n].primary = 0;
+  editorCursorsScatter(all, n + 1);
+  editorSetStatusMessage("%zu cursors (ESC for one)", E.ncursors + 1);
+}
+
+// type the same text at every cursor
+void editorMultiInsert(const char *s, size_t len)
+{
+  size_t n;
+  editorCursor *all = editorCursorsGather(&n);
+
+  struct replaceRec rec;
+  editorReplaceRecStart(&rec, "", 0, s, len);
+
+  size_t *at = malloc(sizeof(size_t) * n);
+  if (at == NULL)
+  {
+    die("malloc");
+  }
+  for (size_t i = 0; i < n;)
+  {
+    // the cursors on this row
+    size_t j = i;
+    size_t y = all[i].cy;
+    if (y == E.numrows)
+    {
+      editorInsertRow(E.numrows, "", 0);
+    }
+    while (j < n && all[j].cy == y)
+    {
+      at[j - i] = all[j].cx;
+      j++;
+    }
+
+    editorReplaceRecRow(&rec, y, at, j - i);
+    editorRowReplaceAt(&E.row[y], at, j - i, 0, s, len);
+    for (size_t k = i; k < j; k++)
+    {
+      all[k].cx += (k - i + 1) * len;
+    }
+    i = j;
+  }
+  free(at);
+
+  editorReplaceRecDone(&rec);
+  editorCursorsScatter(all, n);
+}
+
+// backspace (or delete with forward) at every cursor, never joining lines
+void editorMultiDelete(int forward)
+{
+  size_t n;
+  editorCursor *all = editorCursorsGather(&n);
+  size_t *ranges = malloc(sizeof(size_t) * 2 * n);
+
+  for (size_t i = 0; i < n;)
+  {
+    size_t j = i;
+    size_t y = all[i].cy;
+    while (j < n && all[j].cy == y)
+    {
+      j++;
+    }
+    if (y >= E.numrows)
+    {
+      i = j;
+      continue;
+    }
+
+    // the char each cursor removes, clipped so neighbours don't overlap
+    erow *row = &E.row[y];
+    editorRowWarm(row);
+    size_t prev = 0;
+    for (size_t k = i; k < j; k++)
+    {
+      size_t start = forward ? all[k].cx : editorRowPrevChar(row, all[k].cx);
+      size_t end = forward ? editorRowNextChar(row, all[k].cx) : all[k].cx;
+      start = start < prev ? prev : start;
+      end = end < start ? start : end;
+      ranges[2 * k] = start;
+      ranges[2 * k + 1] = end;
+      prev = end;
+    }
+
+    // one delete per cursor, right to left so each column still holds
+    // when they're replayed one at a time
+    for (size_t k = j; k-- > i;)
+    {
+      size_t start = ranges[2 * k], end = ranges[2 * k + 1];
+      if (end > start)
+      {
+        editorRecordOp(OP_DELETE, y, start, &row->chars[start], end - start);
+      }
+    }
+
+    // then the row is rebuilt once for all of them
+    char *chars = editorTextAlloc(row->size + 1);
+    size_t from = 0, to = 0;
+    for (size_t k = i; k < j; k++)
+    {
+      size_t start = ranges[2 * k];
+      memcpy(&chars[to], &row->chars[from], start - from);
+      to += start - from;
+      from = ranges[2 * k + 1];
+      all[k].cx = to;
+    }
+    memcpy(&chars[to], &row->chars[from], row->size - from);
+    to += row->size - from;
+    chars[to] = '\0';
+
+    editorTextRelease(row->chars);
+    row->chars = chars;
+    row->size = to;
+    editorUpdateRow(row);
+    E.dirty++;
+    i = j;
+  }
+  free(ranges);
+  editorCursorsScatter(all, n);
+}
+
+// move every cursor as if it were the only one
+void editorMultiMove(int key)
+{
+  size_t n;
+  editorCursor *all = editorCursorsGather(&n);
+  size_t cy = E.cy, cx = E.cx;
+  for (size_t i = 0; i < n; i++)
+  {
+    E.cy = all[i].cy;
+    E.cx = all[i].cx;
+    editorMoveCursor(key);
+    all[i].cy = E.cy;
+    all[i].cx = E.cx;
+  }
+  E.cy = cy;
+  E.cx = cx;
+  editorCursorsScatter(all, n);
+}
+
+/**
+ * A key while there are several cursors, returns 1 if it's been handled.
+ * Keys that can't apply to every cursor drop the extra ones first.
+ */
+int editorMultiKey(int c)
+{
+  switch (c)
+  {
+  case '\x1b':
+    editorCursorsClear();
+    editorSetStatusMessage("");
+    return 1;
+  case CTRL_KEY('n'):
+    editorCursorAdd();
+    return 1;
+  case BACKSPACE:
+  case CTRL_KEY('h'):
+  case DEL_KEY:
+    editorMultiDelete(c == DEL_KEY);
+    return 1;
+  case ARROW_LEFT:
+  case ARROW_RIGHT:
+  case ARROW_UP:
+  case ARROW_DOWN:
+  case HOME_KEY:
+  case END_KEY:
+    editorMultiMove(c);
+    return 1;
+  // these don't move the cursor or change the text
+  case CTRL_KEY('s'):
+  case CTRL_KEY('t'):
+  case CTRL_KEY('e'):
+  case CTRL_KEY('g'):
+  case CTRL_KEY('w'):
+  case CTRL_KEY('l'):
+    return 0;
+  }
+
+  if (c == '\t' || (c >= 32 && c < 256 && c != BACKSPACE))
+  {
+    char ch = c;
+    editorMultiInsert(&ch, 1);
+    return 1;
+  }
+  editorCursorsClear();
+  return 0;
+}
+
+/*** selection and clipboard ***/
+
+/**
+ * Ctrl-B sets the mark, moving the cursor then selects from the mark to
+ * it. Ctrl-C copies, Ctrl-X cuts, Ctrl-V pastes. The clipboard keeps
+ * references to the rows' text, not copies, so copying is a refcount
+ * bump per row however big the rows are, and pasting puts whole rows
+ * back by reference - only the partial first and last lines are copied.
+ * Undo and the swap file keep a paste or cut of several rows as one op
+ * that refers to the clipboard, not to the rows' text (editorClipOp).
+ */
+
+// the selection in order, clamped to the buffer; 0 if there's nothing selected
+int editorSelectionBounds(size_t *y0, size_t *x0, size_t *y1, size_t *x1)
+{
+  if (!E.sel.active || E.numrows == 0)
+  {
+    return 0;
+  }
+  size_t ay = E.sel.cy, ax = E.sel.cx, by = E.cy, bx = E.cx;
+  if (ay > by || (ay == by && ax > bx))
+  {
+    size_t ty = ay, tx = ax;
+    ay = by;
+    ax = bx;
+    by = ty;
+    bx = tx;
+  }
+  // the line past the end of the file has no text, stop at the end of the last row
+  if (ay >= E.numrows)
+  {
+    ay = E.numrows - 1;
+    ax = E.row[ay].size;
+  }
+  if (by >= E.numrows)
+  {
+    by = E.numrows - 1;
+    bx = E.row[by].size;
+  }
+  ax = ax > E.row[ay].size ? E.row[ay].size : ax;
+  bx = bx > E.row[by].size ? E.row[by].size : bx;
+  *y0 = ay;
+  *x0 = ax;
+  *y1 = by;
+  *x1 = bx;
+  return ay != by || ax != bx;
+}
+
+// render bytes of 'row' that are selected, for editorDrawRow
+int editorSelectionRowRange(erow *row, size_t *rb0, size_t *rb1)
+{
+  rowDisplay *d = editorRowDisplay(row);
+  size_t y0, x0, y1, x1;
+  if (!editorSelectionBounds(&y0, &x0, &y1, &x1) || ROW_IDX(row) < y0 || ROW_IDX(row) > y1)
+  {
+    return 0;
+  }
+  *rb0 = ROW_IDX(row) == y0 ? editorRowCxToRb(row, x0) : 0;
+  *rb1 = ROW_IDX(row) == y1 ? editorRowCxToRb(row, x1) : d->rsize;
+  return 1;
+}
+
+// drop a reference to a clipboard, its row texts go with the last one
+void editorClipRelease(clipData *clip)
+{
+  if (clip == NULL || --clip->refs > 0)
+  {
+    return;
+  }
+  for (size_t i = 0; i < clip->n; i++)
+  {
+    editorTextRelease(clip->spans[i].text);
+  }
+  free(clip);
+}
+
+void editorClipFree()
+{
+  editorClipRelease(E.clip.data);
+  E.clip.data = NULL;
+}
+
+// a clipboard of n spans, not filled in yet
+clipData *editorClipNew(size_t n)
+{
+  clipData *clip = malloc(sizeof(clipData) + sizeof(clipSpan) * n);
+  if (clip == NULL)
+  {
+    die("malloc");
+  }
+  clip->refs = 1;
+  clip->n = n;
+  clip->bytes = 0;
+  return clip;
+}
+
+// put the text from (y0, x0) to (y1, x1) on the clipboard, by reference
+void editorClipSetRange(size_t y0, size_t x0, size_t y1, size_t x1)
+{
+  editorClipFree();
+  clipData *clip = editorClipNew(y1 - y0 + 1);
+  for (size_t y = y0; y <= y1; y++)
+  {
+    erow *row = &E.row[y];
+    clipSpan *sp = &clip->spans[y - y0];
+    size_t end = (y == y1) ? x1 : row->size;
+    sp->off = (y == y0) ? x0 : 0;
+    sp->len = end - sp->off;
+    sp->whole = sp->off == 0 && end == row->size;
+    sp->cont = row->cont;
+    editorRowWarm(row);
+    sp->text = editorTextRef(row->chars);
+    clip->bytes += sp->len + (y < y1 && !row->cont);
+  }
+  E.clip.data = clip;
+}
+
+/**
+ * Recovery rebuilds the clipboard from the swap file, so every paste
+ * there has to come after a record saying what was on it. A copy is an
+ * OP_CLIP of the range it came from. A copy made while the swap file is
+ * still empty is held back and goes in ahead of the first op (the
+ * buffer is still the file on disk then, which is where replay starts).
+ * When recovery couldn't know the clipboard - it was copied before the
+ * last save, or it's an older one an undo is putting back - its spans
+ * are written out in full, once, as an OP_CLIP_TEXT. A cut holds the
+ * clipboard for its undo too, so a redo of an older cut gives the range
+ * it's about to cut as an OP_CLIP first.
+ */
+void editorJournalClip(clipData *clip)
+{
+  if (E.journal.paused || E.filename == NULL || E.journal.clip == clip)
+  {
+    return;
+  }
+  size_t len = 0;
+  for (size_t i = 0; i < clip->n; i++)
+  {
+    len += 11 + clip->spans[i].len; // varint, flags
+  }
+  char *buf = malloc(len ? len : 1);
+  if (buf == NULL)
+  {
+    return;
+  }
+  len = 0;
+  for (size_t i = 0; i < clip->n; i++)
+  {
+    clipSpan *sp = &clip->spans[i];
+    len += editorPutVarint(&buf[len], sp->len);
+    buf[len++] = sp->whole | sp->cont << 1;
+    memcpy(&buf[len], sp->text + sp->off, sp->len);
+    len += sp->len;
+  }
+  E.journal.clip_deferred = 0;
+  editorJournalOp(OP_CLIP_TEXT, 0, 0, buf, len);
+  free(buf);
+  editorClipRelease(E.journal.clip);
+  E.journal.clip = clip;
+  clip->refs++;
+}
+
+// the clipboard came from this range of the buffer as it is now
+void editorJournalClipRange(clipData *clip, size_t y0, size_t x0, size_t y1, size_t x1)
+{
+  if (E.journal.paused || E.filename == NULL)
+  {
+    return;
+  }
+  editorClipRelease(E.journal.clip);
+  E.journal.clip = clip;
+  clip->refs++;
+  E.journal.clip_y0 = y0;
+  E.journal.clip_x0 = x0;
+  E.journal.clip_y1 = y1;
+  E.journal.clip_x1 = x1;
+  E.journal.clip_deferred = E.journal.fd == -1 && E.journal.len == 0;
+  if (!E.journal.clip_deferred)
+  {
+    clipOp c = {y1, x1, NULL};
+    editorJournalOp(OP_CLIP, y0, x0, (char *)&c, offsetof(clipOp, clip));
+  }
+}
+
+// OP_CLIP_TEXT being replayed: the clipboard from its spans
+void editorClipFromText(const char *text, size_t len)
+{
+  size_t n = 0;
+  for (size_t pos = 0; pos < len; n++)
+  {
+    size_t sl;
+    pos += editorGetVarint(&text[pos], &sl);
+    pos += 1 + sl;
+  }
+  editorClipFree();
+  clipData *clip = editorClipNew(n);
+  size_t pos = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    clipSpan *sp = &clip->spans[i];
+    pos += editorGetVarint(&text[pos], &sp->len);
+    sp->whole = text[pos] & 1;
+    sp->cont = (text[pos] >> 1) & 1;
+    pos++;
+    sp->off = 0;
+    sp->text = editorTextAlloc(sp->len + 1);
+    memcpy(sp->text, &text[pos], sp->len);
+    sp->text[sp->len] = '\0';
+    pos += sp->len;
+    clip->bytes += sp->len + (i + 1 < n && !sp->cont);
+  }
+  E.clip.data = clip;
+}
+
+// Ctrl-C: reference every selected row's text, nothing is copied
+int editorCopy()
+{
+  size_t y0, x0, y1, x1;
+  if (!editorSelectionBounds(&y0, &x0, &y1, &x1))
+  {
+    editorSetStatusMessage("Nothing selected (Ctrl-B sets the mark)");
+    return 0;
+  }
+
+  editorClipSetRange(y0, x0, y1, x1);
+  editorJournalClipRange(E.clip.data, y0, x0, y1, x1);
+
+  char size[16];
+  editorMemFormat(size, sizeof(size), E.clip.data->bytes);
+  editorSetStatusMessage("Copied %s", size);
+  return 1;
+}
+
+// remove the text between two positions, joining what's left of the two rows
+void editorDeleteRange(size_t y0, size_t x0, size_t y1, size_t x1)
+{
+  if (y0 == y1)
+  {
+    editorRowDelString(&E.row[y0], x0, x1 - x0);
+  }
+  else
+  {
+    editorRowDelString(&E.row[y0], x0, E.row[y0].size - x0);
+    editorRowWarm(&E.row[y1]);
+    editorRowAppendString(&E.row[y0], &E.row[y1].chars[x1], E.row[y1].size - x1);
+    editorRowSetCont(&E.row[y0], E.row[y1].cont);
+    editorDelRows(y0 + 1, y1 - y0);
+  }
+  E.cy = y0;
+  E.cx = x0;
+}
+
+/**
+ * Put a clipboard in at (y, x), whole rows by reference in one shift of
+ * the row array. Returns the row the pasted text ends on, and where in
+ * it in *ex. Rows that grew aren't split into chunks here.
+ */
+size_t editorPasteSpans(clipData *clip, size_t y, size_t x, size_t *ex)
+{
+  clipSpan *spans = clip->spans;
+  size_t n = clip->n;
+  if (n == 1)
+  {
+    editorRowInsertString(&E.row[y], x, spans[0].text + spans[0].off, spans[0].len);
+    *ex = x + spans[0].len;
+    return y;
+  }
+
+  // the rest of the cursor's row goes after the last pasted line
+  erow *row = &E.row[y];
+  editorRowWarm(row);
+  size_t taillen = row->size - x;
+  char *tail = malloc(taillen + 1);
+  if (tail == NULL)
+  {
+    die("malloc");
+  }
+  memcpy(tail, &row->chars[x], taillen);
+  int tailcont = row->cont;
+  editorRowDelString(row, x, taillen);
+  editorRowInsertString(row, x, spans[0].text + spans[0].off, spans[0].len);
+  editorRowSetCont(row, spans[0].cont);
+
+  // the rows in between are always whole, they're shared rather than copied
+  size_t mid = n - 2;
+  if (mid)
+  {
+    char **chars = malloc(sizeof(char *) * mid);
+    size_t *lens = malloc(sizeof(size_t) * mid);
+    if (chars == NULL || lens == NULL)
+    {
+      die("malloc");
+    }
+    for (size_t i = 0; i < mid; i++)
+    {
+      chars[i] = editorTextRef(spans[i + 1].text);
+      lens[i] = spans[i + 1].len;
+    }
+    editorInsertRowsText(y + 1, chars, lens, mid);
+    for (size_t i = 0; i < mid; i++)
+    {
+      editorRowSetCont(&E.row[y + 1 + i], spans[i + 1].cont);
+    }
+    free(chars);
+    free(lens);
+  }
+
+  // last line, with the tail after it
+  clipSpan *last = &spans[n - 1];
+  size_t ly = y + 1 + mid;
+  editorInsertRow(ly, last->text + last->off, last->len);
+  editorRowInsertString(&E.row[ly], last->len, tail, taillen);
+  editorRowSetCont(&E.row[ly], tailcont);
+  free(tail);
+  *ex = last->len;
+  return ly;
+}
+
+/**
+ * Do a paste or cut of several rows with undo and the swap file paused,
+ * then record it as the one op: the undo record holds a reference to
+ * the clipboard instead of the rows' text, and the swap file gets just
+ * the range.
+ */
+void editorClipOp(int type, clipData *clip, size_t y0, size_t x0, size_t y1, size_t x1)
+{
+  clipOp c = {y1, x1, clip};
+  // recovery pastes, or keeps for undoing a cut, what it has on its clipboard
+  if (type == OP_PASTE)
+  {
+    editorJournalClip(clip);
+  }
+  else if (E.journal.clip != clip)
+  {
+    editorJournalClipRange(clip, y0, x0, y1, x1);
+  }
+  int undo_paused = E.undo.paused, journal_paused = E.journal.paused;
+  E.undo.paused = 1;
+  E.journal.paused = 1;
+  if (type == OP_PASTE)
+  {
+    c.y1 = editorPasteSpans(clip, y0, x0, &c.x1);
+  }
+  else
+  {
+    editorDeleteRange(y0, x0, y1, x1);
+  }
+  E.undo.paused = undo_paused;
+  E.journal.paused = journal_paused;
+  editorRecordOp(type, y0, x0, (char *)&c, sizeof(c));
+  E.cy = type == OP_PASTE ? c.y1 : y0;
+  E.cx = type == OP_PASTE ? c.x1 : x0;
+}
+
+// Ctrl-X
+void editorCut()
+{
+  size_t y0, x0, y1, x1;
+  if (!editorCopy() || !editorSelectionBounds(&y0, &x0, &y1, &x1))
+  {
+    return;
+  }
+  if (y0 == y1)
+  {
+    editorDeleteRange(y0, x0, y1, x1);
+  }
+  else
+  {
+    editorClipOp(OP_CUT, E.clip.data, y0, x0, y1, x1);
+  }
+  editorRowFitChunks(y0);
+  E.sel.active = 0;
+}
+
+// Ctrl-V
+void editorPaste()
+{
+  if (E.clip.data == NULL)
+  {
+    editorSetStatusMessage("Clipboard is empty");
+    return;
+  }
+  E.sel.active = 0;
+  if (E.cy == E.numrows)
+  {
+    editorInsertRow(E.numrows, "", 0);
+  }
+
+  size_t y = E.cy, x = E.cx;
+  if (E.clip.data->n == 1)
+  {
+    editorPasteSpans(E.clip.data, y, x, &E.cx);
+    editorRowFitChunks(y);
+    return;
+  }
+  editorClipOp(OP_PASTE, E.clip.data, y, x, 0, 0);
+
+  // split anything that grew past the chunk size, the cursor row last
+  editorRowFitChunks(E.cy);
+  size_t before = E.numrows;
+  editorRowFitChunks(y);
+  E.cy += E.numrows - before;
+
+  char size[16];
+  editorMemFormat(size, sizeof(size), E.clip.data->bytes);
+  editorSetStatusMessage("Pasted %s", size);
+}
+
+// Ctrl-B: set the mark at the cursor, or clear it
+void editorToggleMark()
+{
+  E.sel.active = !E.sel.active;
+  E.sel.cy = E.cy;
+  E.sel.cx = E.cx;
+  editorSetStatusMessage(E.sel.active ? "Mark set" : "Mark cleared");
+}
+
+// keys that leave the selection alone, anything else that edits clears it
+int editorSelectionKeeps(int c)
+{
+  switch (c)
+  {
+  case ARROW_LEFT:
+  case ARROW_RIGHT:
+  case ARROW_UP:
+  case ARROW_DOWN:
+  case HOME_KEY:
+  case END_KEY:
+  case PAGE_UP:
+  case PAGE_DOWN:
+  case CTRL_KEY('b'):
+  case CTRL_KEY('c'):
+  case CTRL_KEY('x'):
+  case CTRL_KEY('f'):
+  case CTRL_KEY('s'):
+  case CTRL_KEY('t'):
+  case CTRL_KEY('e'):
+  case CTRL_KEY('g'):
+  case CTRL_KEY('w'):
+  case CTRL_KEY('l'):
+    return 1;
+  }
+  return 0;
+}
+
+/*** input ***/
+
+// called whenever the user hasn't typed anything for a while
+void editorIdle()
+{
+  editorJournalFlush(0);
+  editorWatchPoll();
+  editorFollowPoll();
+  editorViewIdle();
+  editorColdPoll(KILO_COLD_SCAN_BYTES);
+  editorEvictPoll(KILO_COLD_SCAN);
+
+  // terminal was resized while we were waiting for a key
+  if (winch)
+  {
+    editorRefreshScreen();
+  }
+}
+
+char *editorPrompt(char *prompt, void (*callback)(char *, int))
+{
+  return editorPromptRead(prompt, callback, 0);
+}
+
+// allow_empty: Enter on an empty line answers "" rather than being ignored
+char *editorPromptRead(char *prompt, void (*callback)(char *, int), int allow_empty)
+{
+  // creating a 128 byte buffer
+  size_t bufsize = 128;
+  char *buf = malloc(bufsize);
+
+  // end of line char
+  size_t buflen = 0;
+  buf[0] = '\0';
+
+  // reloads and follow mode hold off until we return, see editorIdle
+  int prompting = E.prompting;
+  E.prompting = 1;
+
+  // while true
+  while (1)
+  {
+    // Add a new status message for user
+    editorSetStatusMessage(prompt, buf);
+    // refresh screen to show message
+    editorRefreshScreen();
+
+    // read a key from the user
+    int c = editorReadKey();
+
+    if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE)
+    {
+      if (buflen != 0)
+      {
+        // if we're not currently at beginning of line
+        // replace the last char with an end of line character
+        buf[--buflen] = '\0';
+      }
+    }
+    else if (c == '\x1b')
+    { // if user hit excape, return nothing
+      editorSetStatusMessage("");
+      if (callback)
+      {
+        callback(buf, c);
+      }
+      free(buf);
+      E.prompting = prompting;
+      return NULL;
+    }
+    else if (c == '\r')
+    {
+      // if the key is enter, and current buffer is empty, then return nothign
+      if (buflen != 0 || allow_empty)
+      {
+        editorSetStatusMessage("");
+        if (callback)
+        {
+          callback(buf, c);
+        }
+        E.prompting = prompting;
+        return buf;
+      }
+    }
+    else if ((c < 128 && !iscntrl(c)) || (c >= 128 && c < 256))
+    { // if it's not a ctrl char and c is a valid character
+      // if we've reached the max buffer size, double it
+      if (buflen == bufsize - 1)
+      {
+        bufsize *= 2;
+        buf = realloc(buf, bufsize);
+      }
+      // add c to the buffer
+      buf[buflen++] = c;
+      // add the end of line char to end of buffer
+      buf[buflen] = '\0';
+    }
+
+    // call the callback function
+    if (callback)
+    {
+      callback(buf, c);
+    }
+  }
+}
+
+void editorMoveCursor(int key)
+{
+
+  // Limiting the scroll to right.
+  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+
+  switch (key)
+  {
+  case ARROW_LEFT:
+    if (E.cx != 0)
+    {
+      E.cx = editorRowPrevChar(row, E.cx);
+    }
+    else if (E.cy > 0)
+    {
+      // If users oge soff to left  of the screen, then move them to end of row on next line up
+      E.cy--;
+      E.cx = E.row[E.cy].size;
+      if (E.row[E.cy].cont)
+      {
+        // end of a chunk is the same spot as the start of the next, step a char
+        E.cx = editorRowPrevChar(&E.row[E.cy], E.cx);
+      }
+    }
+    break;
+  case ARROW_RIGHT:
+    if (row && row->cont && E.cx >= row->size)
+    {
+      // end of a chunk is the start of the next one, step over its first char
+      E.cy++;
+      E.cx = editorRowNextChar(&E.row[E.cy], 0);
+    }
+    else if (row && E.cx < row->size)
+    {
+      // changed to allow user to scroll to the right of screen
+      E.cx = editorRowNextChar(row, E.cx);
+      if (row->cont && E.cx == row->size)
+      {
+        E.cy++; // carry on into the next chunk of the line
+        E.cx = 0;
+      }
+    }
+    else if (row && E.cx == row->size)
+    {
+      // If users goes off of left of screen, move them 1 line up and to the end of row.
+      E.cy++;
+      E.cx = 0;
+    }
+    break;
+  case ARROW_UP:
+    if (editorWrapMoveVertical(-1))
+    {
+      break; // moved up a screen line within the wrapped text
+    }
+    if (E.cy != 0)
+    {
+      E.cy--;
+    }
+    break;
+  case ARROW_DOWN:
+    if (editorWrapMoveVertical(1))
+    {
+      break;
+    }
+    // allowing cursor to move past bottom of screen, but not past EoF
+    if (E.cy < E.numrows)
+    {
+      E.cy++;
+    }
+    break;
+  case HOME_KEY:
+    // back to the first chunk of a long line
+    while (E.cy > 0 && E.cy <= E.numrows && E.row[E.cy - 1].cont)
+    {
+      E.cy--;
+    }
+    E.cx = 0;
+    break;
+  case END_KEY:
+    if (E.cy < E.numrows)
+    {
+      // on to the last chunk of a long line
+      while (E.cy + 1 < E.numrows && E.row[E.cy].cont)
+      {
+        E.cy++;
+      }
+      E.cx = E.row[E.cy].size;
+    }
+    break;
+  }
+
+  row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  if (row)
+  {
+    editorRowWarm(row);
+  }
+  size_t rowlen = row ? row->size : 0;
+  if (E.cx > rowlen)
+  {
+    E.cx = rowlen;
+  }
+  // don't leave the cursor in the middle of a UTF-8 char
+  while (row && E.cx > 0 && E.cx < rowlen && ((unsigned char)row->chars[E.cx] & 0xC0) == 0x80)
+  {
+    E.cx--;
+  }
+}
+
+// wait for keypress, handles it later
+void editorProcessKeypress()
+{
+  static int quit_times = KILO_QUIT_TIMES;
+
+  int c = editorReadKey();
+
+  // every op made by this keypress is undone together
+  E.undo.group++;
+
+  if (E.view.active)
+  {
+    editorViewKey(c);
+    return;
+  }
+
+  if (E.ncursors && editorMultiKey(c))
+  {
+    quit_times = KILO_QUIT_TIMES;
+    return;
+  }
+  if (E.sel.active && !editorSelectionKeeps(c))
+  {
+    E.sel.active = 0;
+  }
+  if (E.follow.fd != -1 && !editorFollowKeeps(c))
+  {
+    editorFollowStop(); // editing the buffer ends follow mode
+  }
+
+  switch (c)
+  {
+
+  case '\r': // enter key
+    editorInsertNewline();
+    break;
+
+  case CTRL_KEY('q'):
+    // quit program
+    if (E.dirty && quit_times > 0)
+    {
+      editorSetStatusMessage("Warning, changes will be lost!");
+      quit_times--;
+      return;
+    }
+    editorOutputWrite("\x1b[2J\x1b[H", 7);
+    editorJournalDiscard(); // quitting on purpose, edits are meant to go
+    exit(0);
+    break;
+
+  case CTRL_KEY('s'):
+    // save the buffer to file
+    editorTraceBegin("save", SIZE_MAX);
+    editorSave();
+    editorTraceEnd("save");
+    break;
+
+  // making home key jump to beigging of line
+  case HOME_KEY:
+    // making end key jump to end of line
+  case END_KEY:
+    editorMoveCursor(c);
+    break;
+
+  case CTRL_KEY('f'):
+    // implementing find function
+    editorFind();
+    break;
+
+  case CTRL_KEY('z'):
+    editorUndo();
+    break;
+
+  case CTRL_KEY('y'):
+    editorRedo();
+    break;
+
+  case CTRL_KEY('w'):
+    editorToggleWrap();
+    break;
+
+  case CTRL_KEY('t'):
+    E.stats.overlay = !E.stats.overlay;
+    editorSetStatusMessage("Latency overlay %s (p50/p99)", E.stats.overlay ? "on" : "off");
+    break;
+
+  case CTRL_KEY('e'):
+    editorStatsDump();
+    break;
+
+  case CTRL_KEY('g'):
+    editorMemShow();
+    break;
+
+  case CTRL_KEY('r'):
+    editorReplace();
+    break;
+
+  case CTRL_KEY('n'):
+    editorCursorAdd();
+    break;
+
+  case CTRL_KEY('b'):
+    editorToggleMark();
+    break;
+
+  case CTRL_KEY('c'):
+    if (editorCopy())
+    {
+      E.sel.active = 0;
+    }
+    break;
+
+  case CTRL_KEY('x'):
+    editorCut();
+    break;
+
+  case CTRL_KEY('v'):
+    editorPaste();
+    break;
+
+  case CTRL_KEY('o'):
+    if (E.follow.fd == -1)
+    {
+      editorFollowStart();
+    }
+    else
+    {
+      editorFollowStop();
+    }
+    break;
+
+  case BACKSPACE:
+  case CTRL_KEY('h'):
+  case DEL_KEY:
+    // move cursor and delete character
+    if (c == DEL_KEY)
+    {
+      editorMoveCursor(ARROW_RIGHT);
+    }
+    editorDelChar();
+    break;
+
+  // Move cursor to top or bottom of page
+  case PAGE_DOWN:
+  case PAGE_UP:
+  {
+
+    // Adding scroll capabilties for page up / down
+    if (E.wrap.enabled)
+    {
+      // top or bottom screen line, rows may take several each
+      editorWrapEnsure();
+      editorWrapGotoLine(c == PAGE_UP ? E.wrap.top : E.wrap.top + E.screenrows - 1);
+    }
+    else if (c == PAGE_UP)
+    {
+      E.cy = E.rowoff;
+    }
+    else if (c == PAGE_DOWN)
+    {
+      E.cy = E.rowoff + E.screenrows - 1;
+      if (E.cy > E.numrows)
+      {
+        E.cy = E.numrows;
+      }
+    }
+
+    // can only declare vars inside { }
+    int times = E.screenrows;
+    while (times--)
+    {
+      editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
+    }
+  }
+  break;
+
+  // allowing user to move around screen with wasd keys
+  case ARROW_RIGHT:
+  case ARROW_LEFT:
+  case ARROW_DOWN:
+  case ARROW_UP:
+    editorMoveCursor(c);
+    break;
+
+  case CTRL_KEY('l'):
+  case '\x1b':
+    break;
+
+  default:
+    editorInsertChar(c);
+    break;
+  }
+
+  quit_times = KILO_QUIT_TIMES;
+}
+
+/*** init ***/
+void initEditor()
+{
+  E.cy = 0;
+  E.cx = 0;
+  E.rx = 0;
+  E.rowoff = 0; // scroll to top by default
+  E.coloff = 0;
+  E.numrows = 0; // will only display a single line of text
+  E.row = NULL;
+  E.display = NULL;
+
+  E.dirty = 0; // checking if we're new file or not
+  E.dirty_row = SIZE_MAX;
+  E.dirty_col = 0;
+  E.safe_save = 0;
+  E.disk_exact = 0;
+
+  E.filename = NULL; // initalised to NULL - will stay if there's no file read in
+
+  E.statusmsg[0] = '\0';
+  E.statusmsg_time = 0;
+
+  E.syntax = NULL;
+
+  memset(&E.journal, 0, sizeof(E.journal));
+  E.journal.fd = -1; // swap file is created on the first edit
+
+  // undo arena starts empty, the cap can be changed from the environment
+  memset(&E.undo, 0, sizeof(E.undo));
+  E.undo.limit = KILO_UNDO_LIMIT;
+  E.undo.lost = UINT_MAX;
+  char *undo_limit = getenv("KILO_UNDO_LIMIT");
+  if (undo_limit && strtoull(undo_limit, NULL, 10) > 0)
+  {
+    E.undo.limit = strtoull(undo_limit, NULL, 10);
+  }
+
+  memset(&E.wrap, 0, sizeof(E.wrap)); // soft wrap off until Ctrl-W
+
+  // redraw when the terminal is resized, without SA_RESTART so the key read wakes up
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = editorHandleWinch;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGWINCH, &sa, NULL);
+
+  E.record_fd = -1;
+  E.out.write = editorTermWrite;
+  E.out.ctx = NULL;
+  memset(&E.stats, 0, sizeof(E.stats));
+  memset(&E.trace, 0, sizeof(E.trace)); // off unless --trace
+  memset(E.mem, 0, sizeof(E.mem));
+  E.batch = 0;
+  E.prompting = 0;
+  E.cursors = NULL;
+  E.ncursors = 0;
+  memset(&E.sel, 0, sizeof(E.sel));
+  memset(&E.clip, 0, sizeof(E.clip));
+  memset(&E.watch, 0, sizeof(E.watch));
+  E.watch.fd = -1; // started once a file is open
+  memset(&E.follow, 0, sizeof(E.follow));
+  E.follow.fd = -1;
+  memset(&E.view, 0, sizeof(E.view)); // --view turns it on
+  memset(&E.intern, 0, sizeof(E.intern));
+  memset(&E.cold, 0, sizeof(E.cold));
+  char *budget = getenv("KILO_MEM_BUDGET"); // same as --mem-budget
+  if (budget)
+  {
+    E.cold.budget = editorParseSize(budget);
+  }
+  memset(&E.evict, 0, sizeof(E.evict));
+  budget = getenv("KILO_RENDER_BUDGET"); // same as --render-budget
+  if (budget)
+  {
+    E.evict.budget = editorParseSize(budget);
+  }
+  // window size is asked for by main, the benchmark uses a virtual screen instead
+}
+
+/*** batch mode ***/
+
+/**
+ * kilo --batch SCRIPT FILE... applies the same script to every file
+ * without a terminal. One command per line, '#' starts a comment:
+ *
+ *   goto LINE [COL]       1-based, COL in bytes
+ *   insert TEXT           at the cursor, "\n" breaks the line
+ *   delete [N]            N chars forward from the cursor (default 1)
+ *   delete-line [N]       N whole lines from the cursor's line
+ *   replace-all FROM TO   every match in the file
+ *   save
+ *
+ * Arguments are split on spaces, "double quotes" keep spaces and take
+ * the escapes \n \t \" and \\.
+ */
+
+#define BATCH_MAX_ARGS 4
+
+typedef struct batchCmd
+{
+  int argc;
+  char *argv[BATCH_MAX_ARGS];
+  size_t lens[BATCH_MAX_ARGS];
+  int lineno; // in the script, for errors
+} batchCmd;
+
+// split a script line into arguments in place, returns how many or -1 if malformed
+int editorBatchSplit(char *line, char **argv, size_t *lens)
+{
+  int argc = 0;
+  char *p = line;
+  while (1)
+  {
+    while (*p == ' ' || *p == '\t')
+    {
+      p++;
+    }
+    if (*p == '\0' || *p == '\n' || *p == '#')
+    {
+      return argc;
+    }
+    if (argc == BATCH_MAX_ARGS)
+    {
+      return -1;
+    }
 
-      char *c = &E.row[filerow].render[E.coloff];
-      // getting current char in highlighting array
-      unsigned char *hl = &E.row[filerow].hl[E.coloff];
-      int current_color = -1;
-      int j;
-      for (j = 0; j < len; j++)
+    char *out = p;
+    argv[argc] = out;
+    if (*p == '"')
+    {
+      p++;
+      while (*p && *p != '"')
       {
-        if (iscntrl(c[j]))
-        {
-          // Symbol is @ char or ? if it's not in alphabet
-          char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-          // Highlight differently
-          abAppend(ab, "\x1b[7m", 4);
-          abAppend(ab, &sym, 1);
-          // change back to normal when finished;
-          abAppend(ab, "\x1b[m", 3);
-          if (current_color != -1)
-          {
-            // change back to whatever the normal colour was if we are finished
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-            abAppend(ab, buf, clen);
-          }
-        }
-        else if (hl[j] == HL_NORMAL)
+        if (*p == '\\' && p[1])
         {
-          // Making it a little more efficient
-          if (current_color != -1)
-          {
-            // default colour on normal highlighting
-            abAppend(ab, "\x1b[39m", 5);
-            current_color = -1;
-          }
-          abAppend(ab, &c[j], 1);
+          p++;
+          *out++ = *p == 'n' ? '\n' : *p == 't' ? '\t' : *p;
+          p++;
         }
         else
         {
-          // red colour for digits
-          int color = editorSyntaxToColor(hl[j]);
-          if (color != current_color)
-          {
-            current_color = color;
-            char buf[16];
-            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-            abAppend(ab, buf, clen);
-          }
-          abAppend(ab, &c[j], 1);
+          *out++ = *p++;
         }
       }
-      // ensuring we reset to default after row is checked
-      abAppend(ab, "\x1b[39m", 5);
+      if (*p != '"')
+      {
+        return -1; // unterminated string
+      }
+      p++;
+      if (*p && *p != ' ' && *p != '\t' && *p != '\n')
+      {
+        return -1; // "abc"def
+      }
     }
-
-    abAppend(ab, "\x1b[K", 3); // clear the line
-
-    abAppend(ab, "\r\n", 2);
+    else
+    {
+      while (*p && *p != ' ' && *p != '\t' && *p != '\n')
+      {
+        *out++ = *p++;
+      }
+    }
+    lens[argc] = out - argv[argc];
+    argc++;
+    if (*p)
+    {
+      p++;
+    }
+    *out = '\0';
   }
 }
 
-void editorDrawStatusBar(struct abuf *ab)
+// the commands, how many arguments each takes and whether they're counts
+static const struct
 {
-  // explaining m commands - https://vt100.net/docs/vt100-ug/chapter3.html#SGR
-  abAppend(ab, "\x1b[7m", 4); // escape sequence - switches to inverted colours
-  char status[80], rstatus[80];
-
-  // getting length of row to write
-  // Copying filename / [no name] to buffer
-  int len = snprintf(status, sizeof(status), "%.20s - %d lines %s",
-                     E.filename ? E.filename : "[No Name]", E.numrows, E.dirty ? "(modified)" : "");
-
-  // Render line also includes the current line number at right edge of screen
-  int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d%d", E.syntax ? E.syntax->filetype : "no ft", E.cy + 1, E.numrows);
-
-  // Cut string short if it's too big..
-  if (len > E.screencols)
-  {
-    len = E.screencols;
-  }
-  // write to the screen
-  abAppend(ab, status, len);
+  const char *name;
+  int min_args;
+  int max_args;
+  int numbers; // every argument is a positive number
+} batchOps[] = {
+    {"goto", 1, 2, 1},
+    {"insert", 1, 1, 0},
+    {"delete", 0, 1, 1},
+    {"delete-line", 0, 1, 1},
+    {"replace-all", 2, 2, 0},
+    {"save", 0, 0, 0},
+};
 
-  while (len < E.screencols)
+// check a parsed command before anything runs, returns NULL or what's wrong with it
+const char *editorBatchCheck(batchCmd *cmd)
+{
+  for (size_t i = 0; i < sizeof(batchOps) / sizeof(batchOps[0]); i++)
   {
-    if (E.screencols - len == rlen)
+    if (strcmp(cmd->argv[0], batchOps[i].name) != 0)
     {
-      abAppend(ab, rstatus, rlen);
-      break;
+      continue;
     }
-    else
+    int args = cmd->argc - 1;
+    if (args < batchOps[i].min_args || args > batchOps[i].max_args)
     {
-      abAppend(ab, " ", 1);
-      len++;
+      return "wrong number of arguments";
+    }
+    for (int a = 1; batchOps[i].numbers && a < cmd->argc; a++)
+    {
+      char *end;
+      errno = 0;
+      unsigned long long n = strtoull(cmd->argv[a], &end, 10);
+      if (!isdigit((unsigned char)cmd->argv[a][0]) || *end || errno || n == 0)
+      {
+        return "expected a positive number";
+      }
+    }
+    if (!strcmp(cmd->argv[0], "replace-all") && cmd->lens[1] == 0)
+    {
+      return "nothing to replace";
     }
+    return NULL;
   }
-
-  abAppend(ab, "\x1b[m", 3); // escape sequence - switches back to normal colours
-  abAppend(ab, "\r\n", 2);   // making room for status bar
+  return "unknown command";
 }
 
-void editorDrawMessageBar(struct abuf *ab)
+// first row of the logical line the cursor is on
+size_t editorBatchLineStart(size_t y)
 {
-  abAppend(ab, "\x1b[K", 3);
-
-  int msglen = strlen(E.statusmsg); // getting length of status msg string
-
-  // Ensuring we don't go over assigned width
-  if (msglen > E.screencols)
-  {
-    msglen = E.screencols;
-  }
-  // if there's a status msg and passed time is < 5 seconds
-  // draw the new status message to the screen
-  if (msglen && time(NULL) - E.statusmsg_time < 5)
+  while (y > 0 && y <= E.numrows && E.row[y - 1].cont)
   {
-    abAppend(ab, E.statusmsg, msglen);
+    y--;
   }
+  return y;
 }
 
-// Clears the terminal
-void editorRefreshScreen()
-{
-  editorScroll();
-
-  // init the new dynamic memo string buffer
-  struct abuf ab = ABUF_INIT;
-
-  // removing the cursor flicker
-  abAppend(&ab, "\x1b[?25l", 6); // l = set mode
-
-  // 4 = write 4 bytes
-  // \x1b[2j] -> ESCAPE SEQUENCE
-
-  // \x1b -> escape character
-  // [ -> always follows the escape character
-
-  // J -> clear the screen
-  // 2 -> clear the entire screen
-  // <esc>[1J would clear screen up to where cursor is
-  // write(STDOUT_FILENO, "\x1b[2J", 4);
-  // abAppend(&ab, "\x1b[2J", 4); -> replaced clear screen with clear line in editorDrawRows
-
-  // Reposition cursor to top left corner after refresh
-  // write(STDOUT_FILENO, "\x1b[H", 3);
-  abAppend(&ab, "\x1b[H", 3);
-
-  // draw the ~ symbol at beggining of row
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab);
-  editorDrawMessageBar(&ab);
-
-  // specifying exact position for the cursor to move to
-  //
-  char buf[32];
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1);
-  abAppend(&ab, buf, strlen(buf));
-
-  // returning cursor flicker
-  abAppend(&ab, "\x1b[?25h", 6); // h = reset mode
-
-  // write the buffer to the screen
-  write(STDOUT_FILENO, ab.b, ab.len);
-
-  // free the buffer after the write
-  abFree(&ab);
-}
-
-/*
- * the ... makes this function a variadic function,
- * meaning it can take any number of arguments.
- */
-void editorSetStatusMessage(const char *fmt, ...)
+void editorBatchGoto(size_t line, size_t col)
 {
-  /*
-   * Calls va_Start and va_end on a value of type va_list
-   * last arg before ... must be passed to va_start.
-   * Between start and end, you would call va_arg and pass it type of next arg
-   *
-   */
-
-  // va_list | va_start | va_end come from stdarg.
-  va_list ap;
-  va_start(ap, fmt);
-  // vsnprintf comes from stdio.h
-  // makes out own printf funct. Store result in E.statusmgr
-  vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
-  va_end(ap);
-  E.statusmsg_time = time(NULL); // getting current time
+  size_t y = 0;
+  while (line > 1 && y < E.numrows)
+  {
+    if (!E.row[y].cont)
+    {
+      line--;
+    }
+    y++;
+  }
+  // walk the column along the line's chunk rows
+  while (y < E.numrows && E.row[y].cont && col > E.row[y].size)
+  {
+    col -= E.row[y].size;
+    y++;
+  }
+  E.cy = y;
+  E.cx = y < E.numrows && col > E.row[y].size ? E.row[y].size : col;
+  if (y == E.numrows)
+  {
+    E.cx = 0;
+  }
 }
 
-/*** input ***/
-
-char *editorPrompt(char *prompt, void (*callback)(char *, int))
+// run one command checked by editorBatchCheck, returns 0 or -1 with the reason in the status message
+int editorBatchRun(batchCmd *cmd)
 {
-  // creating a 128 byte buffer
-  size_t bufsize = 128;
-  char *buf = malloc(bufsize);
-
-  // end of line char
-  size_t buflen = 0;
-  buf[0] = '\0';
+  char *op = cmd->argv[0];
+  size_t n = cmd->argc > 1 ? strtoull(cmd->argv[1], NULL, 10) : 1;
 
-  // while true
-  while (1)
+  if (!strcmp(op, "goto"))
   {
-    // Add a new status message for user
-    editorSetStatusMessage(prompt, buf);
-    // refresh screen to show message
-    editorRefreshScreen();
-
-    // read a key from the user
-    int c = editorReadKey();
-
-    if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE)
+    editorBatchGoto(n, cmd->argc > 2 ? strtoull(cmd->argv[2], NULL, 10) - 1 : 0);
+  }
+  else if (!strcmp(op, "insert"))
+  {
+    editorInsertText(cmd->argv[1], cmd->lens[1]);
+  }
+  else if (!strcmp(op, "delete"))
+  {
+    // same as pressing DEL n times, stops at the end of the file
+    while (n-- > 0 && E.cy < E.numrows &&
+           !(E.cy == E.numrows - 1 && E.cx >= E.row[E.cy].size))
     {
-      if (buflen != 0)
-      {
-        // if we're not currently at beginning of line
-        // replace the last char with an end of line character
-        buf[--buflen] = '\0';
-      }
-    }
-    else if (c == '\x1b')
-    { // if user hit excape, return nothing
-      editorSetStatusMessage("");
-      if (callback)
-      {
-        callback(buf, c);
-      }
-      free(buf);
-      return NULL;
+      editorMoveCursor(ARROW_RIGHT);
+      editorDelChar();
     }
-    else if (c == '\r')
+  }
+  else if (!strcmp(op, "delete-line"))
+  {
+    E.cy = editorBatchLineStart(E.cy);
+    E.cx = 0;
+    while (n-- > 0 && E.cy < E.numrows)
     {
-      // if the key is enter, and current buffer is empty, then return nothign
-      if (buflen != 0)
-      {
-        editorSetStatusMessage("");
-        if (callback)
-        {
-          callback(buf, c);
-        }
-        return buf;
-      }
-    }
-    else if (!iscntrl(c) && c < 128)
-    { // if it's not a ctrl char and c is a valid character
-      // if we've reached the max buffer size, double it
-      if (buflen == bufsize - 1)
+      int cont;
+      do
       {
-        bufsize *= 2;
-        buf = realloc(buf, bufsize);
-      }
-      // add c to the buffer
-      buf[buflen++] = c;
-      // add the end of line char to end of buffer
-      buf[buflen] = '\0';
+        cont = E.row[E.cy].cont;
+        editorDelRow(E.cy);
+      } while (cont && E.cy < E.numrows);
     }
-
-    // call the callback function
-    if (callback)
+  }
+  else if (!strcmp(op, "replace-all"))
+  {
+    size_t count = editorReplaceAll(cmd->argv[1], cmd->lens[1], cmd->argv[2], cmd->lens[2]);
+    editorReplaceStatus(count);
+    printf("%s: %s\n", E.filename, E.statusmsg);
+  }
+  else if (!strcmp(op, "save"))
+  {
+    editorSave();
+    printf("%s: %s\n", E.filename, E.statusmsg);
+    if (E.dirty)
     {
-      callback(buf, c);
+      return -1;
     }
   }
+  else
+  {
+    editorSetStatusMessage("bad command '%s'", op);
+    return -1;
+  }
+  return 0;
 }
 
-void editorMoveCursor(int key)
+// drop the current file so the next one starts from a clean editor
+void editorBatchClose()
 {
+  for (size_t i = 0; i < E.numrows; i++)
+  {
+    editorFreeRow(&E.row[i]);
+  }
+  editorFree(MEM_ROWS, E.row);
+  editorFree(MEM_ROWS, E.display);
+  free(E.filename);
+  editorFree(MEM_UNDO, E.undo.buf);
+  editorFree(MEM_JOURNAL, E.journal.pending);
+  free(E.journal.path);
+}
 
-  // Limiting the scroll to right.
-  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+int editorBatchMain(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: kilo --batch SCRIPT FILE...\n");
+    return 2;
+  }
 
-  switch (key)
+  FILE *fp = fopen(argv[0], "r");
+  if (!fp)
   {
-  case ARROW_LEFT:
-    if (E.cx != 0)
-    {
-      E.cx--;
-    }
-    else if (E.cy > 0)
+    fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+    return 2;
+  }
+
+  // parse and check the whole script up front so a typo fails before any file is touched
+  batchCmd *cmds = NULL;
+  int ncmds = 0;
+  char *line = NULL;
+  size_t linecap = 0;
+  int lineno = 0;
+  while (getline(&line, &linecap, fp) != -1)
+  {
+    lineno++;
+    batchCmd cmd;
+    char *copy = strdup(line);
+    cmd.argc = editorBatchSplit(copy, cmd.argv, cmd.lens);
+    cmd.lineno = lineno;
+    if (cmd.argc == -1)
     {
-      // If users oge soff to left  of the screen, then move them to end of row on next line up
-      E.cy--;
-      E.cx = E.row[E.cy].size;
+      fprintf(stderr, "%s:%d: can't parse line\n", argv[0], lineno);
+      return 2;
     }
-    break;
-  case ARROW_RIGHT:
-    if (row && E.cx < row->size)
+    if (cmd.argc == 0)
     {
-      // changed to allow user to scroll to the right of screen
-      E.cx++;
+      free(copy);
+      continue;
     }
-    else if (row && E.cx == row->size)
+    const char *bad = editorBatchCheck(&cmd);
+    if (bad)
     {
-      // If users goes off of left of screen, move them 1 line up and to the end of row.
-      E.cy++;
-      E.cx = 0;
+      fprintf(stderr, "%s:%d: %s: %s\n", argv[0], lineno, cmd.argv[0], bad);
+      return 2;
     }
-    break;
-  case ARROW_UP:
-    if (E.cy != 0)
+    cmds = realloc(cmds, sizeof(batchCmd) * (ncmds + 1));
+    cmds[ncmds++] = cmd;
+  }
+  free(line);
+  fclose(fp);
+
+  int status = 0;
+  for (int f = 1; f < argc; f++)
+  {
+    if (access(argv[f], R_OK) == -1)
     {
-      E.cy--;
+      fprintf(stderr, "%s: %s\n", argv[f], strerror(errno));
+      status = 1;
+      continue;
     }
-    break;
-  case ARROW_DOWN:
-    // allowing cursor to move past bottom of screen, but not past EoF
-    if (E.cy < E.numrows)
+
+    initEditor();
+    E.batch = 1;
+    editorOpen(argv[f]);
+
+    for (int i = 0; i < ncmds; i++)
     {
-      E.cy++;
+      if (editorBatchRun(&cmds[i]) == -1)
+      {
+        fprintf(stderr, "%s: %s:%d: %s\n", argv[f], argv[0], cmds[i].lineno, E.statusmsg);
+        status = 1;
+        break;
+      }
     }
-    break;
+    editorBatchClose();
   }
+  return status;
+}
 
-  row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-  int rowlen = row ? row->size : 0;
-  if (E.cx > rowlen)
-  {
-    E.cx = rowlen;
-  }
+/*** benchmark ***/
+#ifdef KILO_BENCH
+
+/**
+ * Headless benchmark, built by 'make bench' with malloc and realloc
+ * wrapped by the linker so every allocation the editor makes is counted.
+ * Each trace is replayed in a forked child that draws into an 80x24
+ * virtual terminal. One op is everything between two key reads -
+ * handling the key, prompts included, and redrawing. Frames are the
+ * main loop's redraws, timed without the virtual terminal's share.
+ */
+
+#define BENCH_ROWS 24
+#define BENCH_COLS 80
+#define BENCH_SMALL_LINES 1000
+#define BENCH_HUGE_LINES 200000
+
+size_t bench_allocs = 0;
+size_t bench_alloc_bytes = 0;
+
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+  bench_allocs++;
+  bench_alloc_bytes += size;
+  return __real_malloc(size);
 }
 
-// wait for keypress, handles it later
-void editorProcessKeypress()
+void *__wrap_realloc(void *ptr, size_t size)
 {
-  static int quit_times = KILO_QUIT_TIMES;
+  bench_allocs++;
+  bench_alloc_bytes += size;
+  return __real_realloc(ptr, size);
+}
 
-  int c = editorReadKey();
+int bench_replay = 0; // editorReadByte takes its input from the trace
 
-  switch (c)
+struct benchRun
+{
+  const char *trace; // name for the report
+  const char *file;
+  const char *keys; // raw input bytes being replayed
+  size_t len;
+  size_t pos;
+  int at_key; // next byte read starts a new key
+  uint64_t load_ns;
+  uint64_t last_ns; // when the previous key was read
+  size_t last_allocs;
+  size_t last_bytes;
+  uint64_t *ns; // per op samples, sized up front so recording doesn't allocate
+  size_t *allocs;
+  size_t *bytes;
+  size_t n;
+  struct vterm vt;   // what the frames draw into
+  uint64_t term_ns;  // time spent inside the virtual terminal
+  uint64_t draw_ns;  // time building frames, terminal time taken out
+  size_t frames;
+  size_t frame_bytes;
+  size_t frame_escapes;
+  int show_screen;   // print the final screen after the stats
+  FILE *report;
+} B;
+
+uint64_t editorBenchNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+int editorBenchCompare(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// atexit in the child - the trace ran out or it quit, print this run's line of the report
+void editorBenchReport()
+{
+  size_t allocs = 0, bytes = 0;
+  for (size_t i = 0; i < B.n; i++)
   {
+    allocs += B.allocs[i];
+    bytes += B.bytes[i];
+  }
+  qsort(B.ns, B.n, sizeof(uint64_t), editorBenchCompare);
 
-  case '\r': // enter key
-    editorInsertNewline();
-    break;
+  size_t n = B.n ? B.n : 1;
+  double p50 = B.n ? B.ns[(B.n - 1) * 50 / 100] / 1e3 : 0;
+  double p90 = B.n ? B.ns[(B.n - 1) * 90 / 100] / 1e3 : 0;
+  double p99 = B.n ? B.ns[(B.n - 1) * 99 / 100] / 1e3 : 0;
+  double max = B.n ? B.ns[B.n - 1] / 1e3 : 0;
 
-  case CTRL_KEY('q'):
-    // quit program
-    if (E.dirty && quit_times > 0)
+  size_t frames = B.frames ? B.frames : 1;
+
+  fprintf(B.report, "%-8s %-6s %7zu %9.1f %9.1f %9.1f %9.1f %9.1f %10.1f %10.1f %7zu %9.1f %8.1f %9.1f\n",
+          B.trace, B.file, B.n, B.load_ns / 1e6, p50, p90, p99, max,
+          (double)allocs / n, (double)bytes / n, B.frames,
+          (double)B.frame_bytes / frames, (double)B.frame_escapes / frames,
+          B.draw_ns / 1e3 / frames);
+
+  if (B.show_screen)
+  {
+    for (int y = 0; y < B.vt.rows; y++)
     {
-      editorSetStatusMessage("Warning, changes will be lost!");
-      quit_times--;
-      return;
+      struct abuf line = ABUF_INIT;
+      vtermLine(&B.vt, y, &line);
+      fprintf(B.report, "| %.*s\n", (int)line.len, line.b ? line.b : "");
+      abFree(&line);
     }
-    write(STDOUT_FILENO, "\x1b[2J", 4);
-    write(STDOUT_FILENO, "\x1b[H", 3);
-    exit(0);
-    break;
+  }
+  fflush(B.report);
 
-  case CTRL_KEY('s'):
-    // save the buffer to file
-    editorSave();
-    break;
+  editorJournalDiscard(); // don't leave a swap file for the next run to recover
+}
 
-  // making home key jump to beigging of line
-  case HOME_KEY:
-    E.cx = 0;
-    break;
+// frame sink for the benchmark, keeps the virtual terminal's cost apart
+void editorBenchWrite(void *ctx, const char *buf, size_t len)
+{
+  uint64_t start = editorBenchNs();
+  vtermWrite(ctx, buf, len);
+  B.term_ns += editorBenchNs() - start;
+}
 
-    // making end key jump to end of line
-  case END_KEY:
-    if (E.cy < E.numrows)
-    {
-      E.cx = E.row[E.cy].size;
-    }
-    break;
+// one main loop redraw
+void editorBenchFrame()
+{
+  size_t bytes = B.vt.bytes;
+  size_t escapes = B.vt.escapes;
+  uint64_t term = B.term_ns;
+  uint64_t start = editorBenchNs();
 
-  case CTRL_KEY('f'):
-    // implementing find function
-    editorFind();
-    break;
+  editorRefreshScreen();
 
-  case BACKSPACE:
-  case CTRL_KEY('h'):
-  case DEL_KEY:
-    // move cursor and delete character
-    if (c == DEL_KEY)
-    {
-      editorMoveCursor(ARROW_RIGHT);
-    }
-    editorDelChar();
-    break;
+  B.draw_ns += (editorBenchNs() - start) - (B.term_ns - term);
+  B.frame_bytes += B.vt.bytes - bytes;
+  B.frame_escapes += B.vt.escapes - escapes;
+  B.frames++;
+}
 
-  // Move cursor to top or bottom of page
-  case PAGE_DOWN:
-  case PAGE_UP:
+// called at the top of editorReadKey, closes off the op of the previous key
+void editorBenchMark()
+{
+  uint64_t now = editorBenchNs();
+  if (B.last_ns)
   {
+    B.ns[B.n] = now - B.last_ns;
+    B.allocs[B.n] = bench_allocs - B.last_allocs;
+    B.bytes[B.n] = bench_alloc_bytes - B.last_bytes;
+    B.n++;
+  }
+  B.at_key = 1;
+  B.last_allocs = bench_allocs;
+  B.last_bytes = bench_alloc_bytes;
+  B.last_ns = editorBenchNs();
+}
 
-    // Adding scroll capabilties for page up / down
-    if (c == PAGE_UP)
+int editorBenchReadByte(char *c)
+{
+  if (B.pos >= B.len)
+  {
+    if (B.at_key)
     {
-      E.cy = E.rowoff;
+      exit(0); // report comes from atexit
     }
-    else if (c == PAGE_DOWN)
+    return 0; // trace ends inside an escape sequence
+  }
+  *c = B.keys[B.pos++];
+  B.at_key = 0;
+  return 1;
+}
+
+// replay one trace against one file in a child process
+void editorBenchRun(char *path, const char *file, const char *trace, const char *keys, size_t len, int show_screen, FILE *report)
+{
+  fflush(report);
+  pid_t pid = fork();
+  if (pid == -1)
+  {
+    fprintf(stderr, "bench: fork: %s\n", strerror(errno));
+    return;
+  }
+
+  if (pid == 0)
+  {
+    // nothing should reach the real stdout, die() included
+    int null = open("/dev/null", O_WRONLY);
+    if (null == -1 || dup2(null, STDOUT_FILENO) == -1)
     {
-      E.cy = E.rowoff + E.screenrows - 1;
-      if (E.cy > E.numrows)
-      {
-        E.cy = E.numrows;
-      }
+      _exit(1);
     }
 
-    // can only declare vars inside { }
-    int times = E.screenrows;
-    while (times--)
+    initEditor();
+    E.screenrows = BENCH_ROWS - 2;
+    E.screencols = BENCH_COLS;
+
+    memset(&B, 0, sizeof(B));
+    B.trace = trace;
+    B.file = file;
+    B.report = report;
+    B.show_screen = show_screen;
+    vtermInit(&B.vt, BENCH_ROWS, BENCH_COLS);
+    E.out.write = editorBenchWrite;
+    E.out.ctx = &B.vt;
+    atexit(editorBenchReport);
+
+    // at most one op per byte of input
+    B.ns = malloc(sizeof(uint64_t) * (len + 1));
+    B.allocs = malloc(sizeof(size_t) * (len + 1));
+    B.bytes = malloc(sizeof(size_t) * (len + 1));
+    B.keys = keys;
+    B.len = len;
+    bench_replay = 1; // a swap file recovery prompt reads from the trace too
+
+    uint64_t start = editorBenchNs();
+    editorOpen(path);
+    B.load_ns = editorBenchNs() - start;
+
+    while (1)
     {
-      editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
+      editorBenchFrame();
+      editorProcessKeypress();
     }
   }
-  break;
 
-  // allowing user to move around screen with wasd keys
-  case ARROW_RIGHT:
-  case ARROW_LEFT:
-  case ARROW_DOWN:
-  case ARROW_UP:
-    editorMoveCursor(c);
-    break;
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    fprintf(report, "%-8s %-6s failed\n", trace, file);
+  }
+}
 
-  case CTRL_KEY('l'):
-  case '\x1b':
-    break;
+// C-ish source so the syntax highlighter has work to do, returns the temp path
+char *editorBenchMakeFile(size_t lines)
+{
+  char *path = strdup("/tmp/kilo-bench-XXXXXX.c");
+  int fd = mkstemps(path, 2);
+  FILE *fp = fd == -1 ? NULL : fdopen(fd, "w");
+  if (!fp)
+  {
+    fprintf(stderr, "bench: can't create %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
 
-  default:
-    editorInsertChar(c);
-    break;
+  for (size_t i = 0; i < lines; i++)
+  {
+    if (i % 8 == 0)
+    {
+      fprintf(fp, "/* block %zu */\n", i / 8);
+    }
+    else
+    {
+      fprintf(fp, "\tint value_%zu = %zu; // line %zu of the \"benchmark\" file\n", i, i * 7, i);
+    }
   }
+  fclose(fp);
+  return path;
+}
 
-  quit_times = KILO_QUIT_TIMES;
+void editorBenchRepeat(struct abuf *ab, const char *keys, size_t times)
+{
+  for (size_t i = 0; i < times; i++)
+  {
+    abAppend(ab, keys, strlen(keys));
+  }
 }
 
-/*** init ***/
-void initEditor()
+// the standard traces - typing, pasting, searching, scrolling and whole-file scans
+void editorBenchTraces(struct abuf *typing, struct abuf *paste, struct abuf *search, struct abuf *scroll, struct abuf *scan)
 {
-  E.cy = 0;
-  E.cx = 0;
-  E.rx = 0;
-  E.rowoff = 0; // scroll to top by default
-  E.coloff = 0;
-  E.numrows = 0; // will only display a single line of text
-  E.row = NULL;
+  const char *text = "the quick brown fox jumps over the lazy dog ";
+  size_t textlen = strlen(text);
 
-  E.dirty = 0; // checking if we're new file or not
+  // typing: a few screens down, then lines of text with newlines
+  editorBenchRepeat(typing, "\x1b[6~", 3);
+  for (size_t i = 0; i < 3000; i++)
+  {
+    abAppend(typing, i % 60 == 59 ? "\r" : &text[i % textlen], 1);
+  }
 
-  E.filename = NULL; // initalised to NULL - will stay if there's no file read in
+  // pasting: one long run of text that keeps growing a single row
+  editorBenchRepeat(paste, "\x1b[6~", 2);
+  editorBenchRepeat(paste, "\x1b[F", 1);
+  for (size_t i = 0; i < 20000; i++)
+  {
+    abAppend(paste, &text[i % textlen], 1);
+  }
 
-  E.statusmsg[0] = '\0';
-  E.statusmsg_time = 0;
+  // searching: type a query, step through matches, accept
+  for (int i = 0; i < 20; i++)
+  {
+    editorBenchRepeat(search, "\x06value_1", 1);
+    editorBenchRepeat(search, "\x1b[B", 20);
+    editorBenchRepeat(search, "\r", 1);
+  }
 
-  E.syntax = NULL;
+  // scrolling: page and line moves both ways
+  editorBenchRepeat(scroll, "\x1b[6~", 200);
+  editorBenchRepeat(scroll, "\x1b[B", 500);
+  editorBenchRepeat(scroll, "\x1b[5~", 200);
+  editorBenchRepeat(scroll, "\x1b[A", 200);
 
-  // Check if we could get window size on init
-  if (getWindowSize(&E.screenrows, &E.screencols) == -1)
+  // scanning: passes over every row - a search and a replace that find
+  // nothing, and a line added and removed at the top, moving all the rows
+  for (int i = 0; i < 10; i++)
   {
-    die("getWindowSize");
+    editorBenchRepeat(scan, "\x06zzzq\r", 1);
+    editorBenchRepeat(scan, "\x12zzzq\rx\r", 1);
+    editorBenchRepeat(scan, "\r\x7f", 1);
+  }
+}
+
+/**
+ * kilo --bench [lines]       standard traces on a small and a huge file
+ * kilo --bench FILE TRACE    replay a trace made with --record on FILE
+ */
+int editorBenchMain(int argc, char **argv)
+{
+  // own copy of stdout, the children point STDOUT_FILENO at /dev/null
+  FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+  if (!report)
+  {
+    report = stderr;
+  }
+  fprintf(report, "%-8s %-6s %7s %9s %9s %9s %9s %9s %10s %10s %7s %9s %8s %9s\n",
+          "trace", "file", "ops", "load_ms", "p50_us", "p90_us", "p99_us", "max_us", "allocs/op", "bytes/op",
+          "frames", "out_B/fr", "esc/fr", "draw_us/fr");
+
+  if (argc == 2)
+  {
+    FILE *fp = fopen(argv[1], "r");
+    if (!fp)
+    {
+      fprintf(stderr, "bench: %s: %s\n", argv[1], strerror(errno));
+      return 1;
+    }
+    struct abuf keys = ABUF_INIT;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+      abAppend(&keys, buf, n);
+    }
+    fclose(fp);
+
+    editorBenchRun(argv[0], "file", "recorded", keys.b, keys.len, 1, report);
+    abFree(&keys);
+    fclose(report);
+    return 0;
+  }
+
+  size_t huge = argc == 1 ? strtoull(argv[0], NULL, 10) : BENCH_HUGE_LINES;
+  struct
+  {
+    const char *name;
+    char *path;
+  } files[] = {
+      {"small", editorBenchMakeFile(BENCH_SMALL_LINES)},
+      {"huge", editorBenchMakeFile(huge ? huge : BENCH_HUGE_LINES)},
+  };
+
+  struct abuf traces[5] = {ABUF_INIT, ABUF_INIT, ABUF_INIT, ABUF_INIT, ABUF_INIT};
+  const char *names[5] = {"typing", "paste", "search", "scroll", "scan"};
+  editorBenchTraces(&traces[0], &traces[1], &traces[2], &traces[3], &traces[4]);
+
+  for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+  {
+    for (int t = 0; t < 5; t++)
+    {
+      editorBenchRun(files[f].path, files[f].name, names[t], traces[t].b, traces[t].len, 0, report);
+    }
+    unlink(files[f].path);
+    free(files[f].path);
   }
 
-  E.screenrows -= 2; // Decremented so editor doesnt draw rows at bottom of screen
-  // Allows us to make the status bar and message bars
+  for (int t = 0; t < 5; t++)
+  {
+    abFree(&traces[t]);
+  }
+  fclose(report);
+  return 0;
 }
 
+#endif
+
 /*** init ***/
 int main(int argc, char *argv[])
 {
+#ifdef KILO_BENCH
+  if (argc > 1 && !strcmp(argv[1], "--bench"))
+  {
+    return editorBenchMain(argc - 2, argv + 2);
+  }
+#endif
+
+  if (argc > 1 && !strcmp(argv[1], "--batch"))
+  {
+    return editorBatchMain(argc - 2, argv + 2);
+  }
+
   enableRawMode();
   initEditor();
-  // if there's a file, open the file
-  if (argc >= 2)
+  editorUpdateWindowSize(); // real terminal size, less the status and message bars
+
+  char *filename = NULL;
+  char *view = NULL;
+  int follow = 0;
+  for (int i = 1; i < argc; i++)
   {
+    if (!strcmp(argv[i], "--safe-save"))
+    {
+      E.safe_save = 1; // always save through a temp file + rename
+    }
+    else if (!strcmp(argv[i], "--view") && i + 1 < argc)
+    {
+      view = argv[++i]; // read-only pager, nothing is loaded
+    }
+    else if (!strcmp(argv[i], "--mem-budget") && i + 1 < argc)
+    {
+      E.cold.budget = editorParseSize(argv[++i]); // compress rows away from the screen past this
+    }
+    else if (!strcmp(argv[i], "--render-budget") && i + 1 < argc)
+    {
+      E.evict.budget = editorParseSize(argv[++i]); // drop render / hl of rows not drawn lately past this
+    }
+    else if (!strcmp(argv[i], "--follow"))
+    {
+      follow = 1; // tail the file, see editorFollowStart
+    }
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+    {
+      editorTraceStart(argv[++i]); // Chrome trace JSON written on exit
+    }
+    else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+    {
+      // keystroke trace for the benchmark, see 'make bench'
+      E.record_fd = open(argv[++i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (E.record_fd == -1)
+      {
+        die("open");
+      }
+    }
+    else
+    {
+      filename = argv[i];
+    }
+  }
 
-    editorOpen(argv[1]);
+  // if there's a file, open the file
+  if (view)
+  {
+    editorViewOpen(view);
+  }
+  else if (filename)
+  {
+    editorOpen(filename);
   }
 
-  editorSetStatusMessage("HELP: CTRL-S = save | Ctrl-Q = quit | Ctrl-F = find");
+  if (E.statusmsg[0] == '\0') // opening may have had something to say
+  {
+    editorSetStatusMessage("HELP: CTRL-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-Z/Y = undo/redo");
+  }
+  if (filename && follow)
+  {
+    editorFollowStart();
+  }
 
   while (1)
   {
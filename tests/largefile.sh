@@ -0,0 +1,46 @@
+#!/bin/sh
+# Open, search, edit and save a file past 4GB through --batch.
+# The file is sparse, so it takes no disk space beyond a few blocks:
+#
+#   line 1  "first line"
+#   line 2  4.4GB of NULs
+#   line 3  "marker line"     <- starts past the 4GB mark
+#   line 4  "tail"
+#
+# usage: tests/largefile.sh [KILO]   (default ./Kilo)
+
+KILO=${1:-./Kilo}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+HOLE=4400000000
+FILE=$DIR/big.txt
+printf 'first line\n' > "$FILE"
+truncate -s $HOLE "$FILE" || exit 1
+printf '\nmarker line\ntail\n' >> "$FILE"
+
+# "marker line" -> "markerX line" -> "MARKX line"
+cat > "$DIR/script" <<'END'
+goto 3 7
+insert "X"
+replace-all marker MARK
+save
+END
+
+fail()
+{
+  echo "largefile: $1" >&2
+  exit 1
+}
+
+"$KILO" --batch "$DIR/script" "$FILE" || fail "kilo --batch failed"
+
+size=$(wc -c < "$FILE")
+[ "$size" -eq $((HOLE + 17)) ] || fail "size is $size, expected $((HOLE + 17))"
+
+# the byte before line 3 is still the newline ending the NULs
+got=$(tail -c +$((HOLE + 1)) "$FILE")
+[ "$got" = "$(printf '\nMARKX line\ntail')" ] || fail "bytes at $HOLE are '$got'"
+[ "$(head -c 11 "$FILE")" = "first line" ] || fail "first line changed"
+
+echo "largefile: ok"